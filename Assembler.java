@@ -40,10 +40,30 @@ public class Assembler {
         return symbolTable.containsKey(token) ? symbolTable.get(token) : Integer.parseInt(token, 16);
     }
 
+    // which register fields of an opcode name vector registers: bit 0 for r0, bit 1 for r1, bit 2 for r2
+    // (keep in sync with assembler.cpp)
+    private static int vectorRegisterFields(int opcode) {
+        switch (opcode) {
+            case 0x19: case 0x1A: return 1; // VLOAD Vd Rb Ri imm, VSTR Vs Rb Ri imm
+            case 0x1B: case 0x1C: return 7; // VADD/VMUL Vd Va Vb
+            case 0x1D: return 2;            // VRED Rd Va
+            default: return 0;
+        }
+    }
+
+    // a vector register field could hold up to 15, but only V0..V7 exist
+    private static void checkVectorRegisters(int opcode, int[] fields, String inputLine) throws Exception {
+        for (int i = 0; i < fields.length; i++) {
+            if (((vectorRegisterFields(opcode) >> i) & 1) != 0 && fields[i] >= 8) {
+                throw new Exception("Operand " + fields[i] + " is not a vector register (V0..V7): " + inputLine);
+            }
+        }
+    }
+
     // method to populate the mnemonic table
     // to create/update/delete mnemonics, just edit this method
     private static HashMap<String, Mnemonic> initMnemonicTable() {
-        HashMap<String, Mnemonic> table = new HashMap<String, Mnemonic>(23);
+        HashMap<String, Mnemonic> table = new HashMap<String, Mnemonic>(30);
 
         table.put("LOAD", new Mnemonic(0x0,InstType.TYPEA));
         table.put("STR", new Mnemonic(0x1,InstType.TYPEA));
@@ -68,6 +88,13 @@ public class Assembler {
         table.put("BRN", new Mnemonic(0x14,InstType.TYPEC));
         table.put("JUMP", new Mnemonic(0x15,InstType.TYPED));
         table.put("SUBJ", new Mnemonic(0x16,InstType.TYPED));
+        table.put("RDCTR", new Mnemonic(0x17,InstType.TYPED));
+        table.put("RSTCTR", new Mnemonic(0x18,InstType.TYPED));
+        table.put("VLOAD", new Mnemonic(0x19,InstType.TYPEA));
+        table.put("VSTR", new Mnemonic(0x1A,InstType.TYPEA));
+        table.put("VADD", new Mnemonic(0x1B,InstType.TYPEA));
+        table.put("VMUL", new Mnemonic(0x1C,InstType.TYPEA));
+        table.put("VRED", new Mnemonic(0x1D,InstType.TYPEB));
         table.put("HALT", new Mnemonic(0xFF,null)); // HALT is special instruction of all 1s
 
         return table;
@@ -96,6 +123,9 @@ public class Assembler {
         for (int i = 0; i < 16; i++) {
             symbolTable.put("R" + i, i);
         }
+        for (int i = 0; i < 8; i++) {
+            symbolTable.put("V" + i, i);
+        }
 
         int curLocation = 0;
 
@@ -166,12 +196,14 @@ public class Assembler {
                         r1 = getOperand(tokens.elementAt(2), symbolTable);
                         r2 = getOperand(tokens.elementAt(3), symbolTable);
                         imm = getOperand(tokens.elementAt(4), symbolTable);
+                        checkVectorRegisters(opcode, new int[] {r0, r1, r2}, inputLine);
                         encodedInst = getTypeAInst(opcode, r0, r1, r2, imm);
                         break;
                     case InstType.TYPEB:
                         r0 = getOperand(tokens.elementAt(1), symbolTable);
                         r1 = getOperand(tokens.elementAt(2), symbolTable);
                         imm = getOperand(tokens.elementAt(3), symbolTable);
+                        checkVectorRegisters(opcode, new int[] {r0, r1}, inputLine);
                         encodedInst = getTypeBInst(opcode, r0, r1, imm);
                         break;
                     case InstType.TYPEC:
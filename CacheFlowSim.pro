@@ -9,6 +9,8 @@ SOURCES += \
     SimulatorWindow.cpp \
     basicsimulator.cpp \
     memoryUI.cpp \
+    assembler.cpp \
+    breakpoints.cpp \
     main.cpp
 
 HEADERS += \
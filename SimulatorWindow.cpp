@@ -2,7 +2,8 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QFileDialog>
-#include <sstream>
+#include <QTextBlock>
+#include <QTextCursor>
 
 SimulatorWindow::SimulatorWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -24,6 +25,7 @@ SimulatorWindow::SimulatorWindow(QWidget *parent)
     QPushButton* runButton = new QPushButton("Run Cycles");
     QPushButton* runToEndButton = new QPushButton("Run to End");
     QPushButton* runToBpButton = new QPushButton("Run to Breakpoint");
+    liveButton = new QPushButton("Run Live");
     QPushButton* stepButton = new QPushButton("Step");
     QPushButton* viewRegButton = new QPushButton("View Registers");
     QPushButton* viewMemButton = new QPushButton("View Memory");
@@ -40,7 +42,8 @@ SimulatorWindow::SimulatorWindow(QWidget *parent)
     memLineInput->setPlaceholderText("Start Line");
 
     breakpointInput = new QLineEdit();
-    breakpointInput->setPlaceholderText("Breakpoint PC");
+    breakpointInput->setPlaceholderText("Breakpoints, e.g. 12, 20 if R3 == 5, R4 >= 100, mem 64-79 rw");
+    breakLabel = new QLabel();
 
     // Labels
     cycleLabel = new QLabel("Cycles: 0");
@@ -62,6 +65,7 @@ SimulatorWindow::SimulatorWindow(QWidget *parent)
     layout->addWidget(runButton);
     layout->addWidget(runToEndButton);
     layout->addWidget(runToBpButton);
+    layout->addWidget(liveButton);
     layout->addWidget(stepButton);
     layout->addWidget(viewRegButton);
     layout->addWidget(viewMemButton);
@@ -70,6 +74,7 @@ SimulatorWindow::SimulatorWindow(QWidget *parent)
     layout->addWidget(memLevelInput);
     layout->addWidget(memLineInput);
     layout->addWidget(breakpointInput);
+    layout->addWidget(breakLabel);
     layout->addWidget(cycleLabel);
     layout->addWidget(pcLabel);
 
@@ -97,6 +102,7 @@ SimulatorWindow::SimulatorWindow(QWidget *parent)
     connect(runButton, &QPushButton::clicked, this, &SimulatorWindow::runCycles);
     connect(runToEndButton, &QPushButton::clicked, this, &SimulatorWindow::runToCompletion);
     connect(runToBpButton, &QPushButton::clicked, this, &SimulatorWindow::runToBreakpoint);
+    connect(liveButton, &QPushButton::clicked, this, &SimulatorWindow::runLive);
     connect(stepButton, &QPushButton::clicked, this, &SimulatorWindow::stepCycle);
     connect(viewRegButton, &QPushButton::clicked, this, &SimulatorWindow::viewRegisters);
     connect(viewMemButton, &QPushButton::clicked, this, &SimulatorWindow::viewMemory);
@@ -104,6 +110,12 @@ SimulatorWindow::SimulatorWindow(QWidget *parent)
     connect(pipelineToggle, &QCheckBox::stateChanged, this, &SimulatorWindow::updateModeLabel);
     connect(cacheToggle, &QCheckBox::stateChanged, this, &SimulatorWindow::updateModeLabel);
 
+    // runs a chunk of cycles per frame while "Run Live" is on
+    liveTimer = new QTimer(this);
+    liveTimer->setInterval(16);
+    connect(liveTimer, &QTimer::timeout, this, &SimulatorWindow::liveFrame);
+
+    simulator.trackMemoryChanges(true);
     updateModeLabel();
 }
 
@@ -112,16 +124,21 @@ SimulatorWindow::SimulatorWindow(QWidget *parent)
 void SimulatorWindow::loadProgram() {
     QString fileName = QFileDialog::getOpenFileName(this, "Open Program File", "", "Program Files (*.txt *.bin)");
     if (!fileName.isEmpty()) {
-        simulator.loadProgramFromFile(fileName.toStdString());
+        if (!simulator.loadProgramFromFile(fileName.toStdString())) {
+            QString errors = "Could not load " + fileName + ":\n";
+            for (const string& error : simulator.getLoadErrors())
+                errors += QString::fromStdString(error) + "\n";
+            memoryDisplay->setPlainText(errors);
+            return;
+        }
+        rebuildMemoryPanel();
         updatePipelineDisplay();
     }
 }
 
 void SimulatorWindow::runCycles() {
     int cycles = cycleInput->text().toInt();
-    for (int i = 0; i < cycles; ++i) {
-        if (simulator.step() == FLAG_HALT) break;
-    }
+    if (cycles > 0) simulator.run(cycles);
     updatePipelineDisplay();
 }
 
@@ -131,17 +148,45 @@ void SimulatorWindow::stepCycle() {
 }
 
 void SimulatorWindow::runToCompletion() {
-    while (simulator.step() == FLAG_RUNNING) {}
+    while (simulator.run(1000000) == FLAG_RUNNING) {}
     updatePipelineDisplay();
 }
 
 void SimulatorWindow::runToBreakpoint() {
-    bool ok;
-    int bp = breakpointInput->text().toInt(&ok);
-    if (!ok) return;
+    std::string error;
+    if (!simulator.setBreakpoints(breakpointInput->text().toStdString(), error)) {
+        breakLabel->setText(QString::fromStdString(error));
+        return;
+    }
+
+    int flag;
+    while ((flag = simulator.run(1000000)) == FLAG_RUNNING) {}
+    breakLabel->setText(flag == FLAG_BREAK ? "Stopped: " + QString::fromStdString(simulator.getBreakReason())
+                                           : QString("Program halted."));
+    updatePipelineDisplay();
+}
+
+void SimulatorWindow::runLive() {
+    if (liveTimer->isActive()) {
+        liveTimer->stop();
+        liveButton->setText("Run Live");
+        return;
+    }
+    breakLabel->clear();
+    liveTimer->start();
+    liveButton->setText("Stop");
+}
 
-    while (simulator.getProgramCounter() != bp && simulator.step() == FLAG_RUNNING) {}
+// cycles per frame come from the cycle input (1000 if empty)
+void SimulatorWindow::liveFrame() {
+    int cycles = cycleInput->text().toInt();
+    int flag = simulator.run(cycles > 0 ? cycles : 1000);
     updatePipelineDisplay();
+    if (flag == FLAG_RUNNING) return;
+    liveTimer->stop();
+    liveButton->setText("Run Live");
+    breakLabel->setText(flag == FLAG_BREAK ? "Stopped: " + QString::fromStdString(simulator.getBreakReason())
+                                           : QString("Program halted."));
 }
 
 void SimulatorWindow::viewRegisters() {
@@ -149,6 +194,11 @@ void SimulatorWindow::viewRegisters() {
     for (int i = 0; i < NUM_REGISTERS; ++i) {
         text += QString("R%1: %2\n").arg(i, 2, 10, QLatin1Char('0')).arg(simulator.viewRegister(i));
     }
+    for (int i = 0; i < NUM_VECTOR_REGISTERS; ++i) {
+        text += QString("V%1:").arg(i);
+        for (int j = 0; j < VECTOR_WIDTH; ++j) text += QString(" %1").arg(simulator.viewVectorElement(i, j));
+        text += "\n";
+    }
     registerDisplay->setText(text);
 }
 
@@ -156,27 +206,28 @@ void SimulatorWindow::viewMemory() {
     int level = memLevelInput->text().toInt();
     int startLine = memLineInput->text().toInt();
 
-    if (level != 0 && level != 1) {
+    if (level != LEVEL_RAM && level != LEVEL_CACHE) {
         memoryDisplay->setPlainText("Invalid level. Use 0 for RAM or 1 for Cache.");
         return;
     }
 
-    std::ostringstream out;
-    std::streambuf* old = std::cout.rdbuf(out.rdbuf());
-
-    for (int i = startLine; i < startLine + 10; ++i) {
-        simulator.viewMemory(level, i);
+    // every cache line is always shown, the start line only moves the RAM window
+    if (level == LEVEL_RAM) {
+        int lastStart = RAM_SIZE / simulator.getLineWords() - RAM_PANEL_LINES;
+        ramPanelLine = std::max(0, std::min(startLine, lastStart));
     }
-
-    std::cout.rdbuf(old);
-    memoryDisplay->setPlainText(QString::fromStdString(out.str()));
+    rebuildMemoryPanel();
 }
 
 void SimulatorWindow::resetSimulator() {
+    liveTimer->stop();
+    liveButton->setText("Run Live");
     simulator = Simulator(pipelineToggle->isChecked(), cacheToggle->isChecked());
+    simulator.trackMemoryChanges(true);
+    rebuildMemoryPanel(); // same row count as before, so a refresh alone would keep the old simulator's memory
     updatePipelineDisplay();
     registerDisplay->clear();
-    memoryDisplay->clear();
+    breakLabel->clear();
 }
 
 // display update logic ==========
@@ -195,7 +246,8 @@ void SimulatorWindow::updatePipelineDisplay() {
     int instrs = simulator.getInstructionCount();
     int cycles = simulator.getCycleCount();
     double cpi = (instrs == 0) ? 0.0 : static_cast<double>(cycles) / instrs;
-    cpiLabel->setText("CPI: " + QString::number(cpi, 'f', 2));
+    cpiLabel->setText(QString("CPI: %1  Instructions: %2  Stall Cycles: %3  Branch Flushes: %4")
+                      .arg(cpi, 0, 'f', 2).arg(instrs).arg(simulator.getStallCycles()).arg(simulator.getBranchFlushes()));
 
     int hits = simulator.getCacheHits();
     int misses = simulator.getCacheMisses();
@@ -204,26 +256,62 @@ void SimulatorWindow::updatePipelineDisplay() {
     hitMissLabel->setText(QString("Hits: %1  Misses: %2  Hit Rate: %3%")
                           .arg(hits).arg(misses).arg(hitRate, 0, 'f', 1));
 
-    // Memory summary
-    QString memText = "CACHE (Lines 0–3):\n";
-    for (int i = 0; i < 4; ++i) {
-        std::ostringstream out;
-        std::streambuf* old = std::cout.rdbuf(out.rdbuf());
-        simulator.viewMemory(1, i);
-        std::cout.rdbuf(old);
-        memText += QString::fromStdString(out.str());
-    }
+    refreshMemoryPanel();
+}
 
-    memText += "\nRAM (Lines 0–3):\n";
-    for (int i = 0; i < 4; ++i) {
-        std::ostringstream out;
-        std::streambuf* old = std::cout.rdbuf(out.rdbuf());
-        simulator.viewMemory(0, i);
-        std::cout.rdbuf(old);
-        memText += QString::fromStdString(out.str());
-    }
+// memory panel ==========
+
+// header, cache lines, blank, header, RAM lines
+int SimulatorWindow::memoryPanelRows() const {
+    return simulator.getCacheLineCount() + RAM_PANEL_LINES + 3;
+}
+
+QString SimulatorWindow::cacheLineText(int line) const {
+    CacheLineView view = simulator.inspectCacheLine(line);
+    QString text = QString("Cache Line %1 [Valid: %2, Tag: %3, Dirty: %4] -")
+                   .arg(line).arg(int(view.valid)).arg(view.tag).arg(int(view.dirty));
+    for (int value : view.data) text += " " + QString::number(value);
+    return text;
+}
+
+QString SimulatorWindow::ramLineText(int line) const {
+    QString text = QString("RAM Line %1 -").arg(line);
+    for (int value : simulator.inspectRam(line * simulator.getLineWords(), simulator.getLineWords()))
+        text += " " + QString::number(value);
+    return text;
+}
 
-    memoryDisplay->setPlainText(memText);
+void SimulatorWindow::setMemoryPanelRow(int row, const QString& text) {
+    QTextBlock block = memoryDisplay->document()->findBlockByNumber(row);
+    if (!block.isValid()) return;
+    QTextCursor cursor(block);
+    cursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
+    cursor.insertText(text);
+}
+
+void SimulatorWindow::rebuildMemoryPanel() {
+    simulator.takeMemoryChanges(); // everything is redrawn, so the pending changes are covered
+    QStringList rows;
+    rows << "CACHE:";
+    for (int i = 0; i < simulator.getCacheLineCount(); ++i) rows << cacheLineText(i);
+    rows << "" << QString("RAM (Lines %1–%2):").arg(ramPanelLine).arg(ramPanelLine + RAM_PANEL_LINES - 1);
+    for (int i = ramPanelLine; i < ramPanelLine + RAM_PANEL_LINES; ++i) rows << ramLineText(i);
+    memoryDisplay->setPlainText(rows.join("\n"));
+}
+
+// redraws only the lines the simulator logged as changed since the last frame
+void SimulatorWindow::refreshMemoryPanel() {
+    if (memoryDisplay->document()->blockCount() != memoryPanelRows()) {
+        rebuildMemoryPanel(); // showing something else (load errors, cleared), start over
+        return;
+    }
+    int ramRow = simulator.getCacheLineCount() + 3;
+    for (const LineChange& change : simulator.takeMemoryChanges()) {
+        if (change.level == LEVEL_CACHE)
+            setMemoryPanelRow(1 + change.line, cacheLineText(change.line));
+        else if (change.line >= ramPanelLine && change.line < ramPanelLine + RAM_PANEL_LINES)
+            setMemoryPanelRow(ramRow + change.line - ramPanelLine, ramLineText(change.line));
+    }
 }
 
 void SimulatorWindow::updateModeLabel() {
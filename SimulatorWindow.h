@@ -7,6 +7,7 @@
 #include <QLabel>
 #include <QTextEdit>
 #include <QCheckBox>
+#include <QTimer>
 #include "basicsimulator.cpp"
 
 class SimulatorWindow : public QMainWindow {
@@ -25,6 +26,8 @@ private slots:
     void runToCompletion();
     void updateModeLabel();
     void runToBreakpoint();
+    void runLive();
+    void liveFrame();
 
 private:
     Simulator simulator;
@@ -35,6 +38,7 @@ private:
     QLabel* modeLabel;
     QLabel* cpiLabel;
     QLabel* hitMissLabel;
+    QLabel* breakLabel;
 
     QTextEdit* registerDisplay;
     QTextEdit* memoryDisplay;
@@ -47,7 +51,20 @@ private:
     QCheckBox* pipelineToggle;
     QCheckBox* cacheToggle;
 
+    QPushButton* liveButton;
+    QTimer* liveTimer;
+
+    // memory panel: every cache line, then RAM_PANEL_LINES RAM lines from ramPanelLine
+    static const int RAM_PANEL_LINES = 16;
+    int ramPanelLine = 0;
+
     void updatePipelineDisplay();
+    int memoryPanelRows() const;
+    QString cacheLineText(int line) const;
+    QString ramLineText(int line) const;
+    void setMemoryPanelRow(int row, const QString& text);
+    void rebuildMemoryPanel();
+    void refreshMemoryPanel();
 };
 
 #endif // SIMULATORWINDOW_H
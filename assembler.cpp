@@ -0,0 +1,328 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cctype>
+
+using namespace std;
+
+// C++ port of Assembler.java, so programs can be loaded without going through the JVM
+// accepts the same syntax: hex operands, R0..R15 (and V0..V7 for the vector extension), labels at the start of a line and # comments
+
+constexpr int INST_TYPE_A = 0;
+constexpr int INST_TYPE_B = 1;
+constexpr int INST_TYPE_C = 2;
+constexpr int INST_TYPE_D = 3;
+constexpr int INST_TYPE_HALT = 4;
+constexpr int NUM_VECTOR_REGISTERS = 8; // V0..V7, named by 4-bit register fields like R0..R15
+
+struct Mnemonic {
+    int opcode;
+    int type;
+};
+
+struct AssemblyResult {
+    vector<unsigned int> words;
+    vector<string> errors; // each one is prefixed with "line N: "
+    bool ok() const { return errors.empty(); }
+};
+
+class Assembler {
+private:
+    struct SourceLine {
+        int line_number;
+        vector<string> tokens;
+    };
+
+    // to create/update/delete mnemonics, just edit this table (keep it in sync with Assembler.java)
+    static const unordered_map<string, Mnemonic>& mnemonicTable() {
+        static const unordered_map<string, Mnemonic> table = {
+            {"LOAD", {0x0, INST_TYPE_A}},
+            {"STR", {0x1, INST_TYPE_A}},
+            {"MOV", {0x2, INST_TYPE_A}},
+            {"LOADI", {0x3, INST_TYPE_D}},
+            {"LOADIZ", {0x4, INST_TYPE_D}},
+            {"ADD", {0x5, INST_TYPE_A}},
+            {"ADDI", {0x6, INST_TYPE_B}},
+            {"SUB", {0x7, INST_TYPE_A}},
+            {"SUBI", {0x8, INST_TYPE_B}},
+            {"MUL", {0x9, INST_TYPE_A}},
+            {"MULI", {0xA, INST_TYPE_B}},
+            {"DIV", {0xB, INST_TYPE_A}},
+            {"DIVI", {0xC, INST_TYPE_B}},
+            {"MOD", {0xD, INST_TYPE_A}},
+            {"MODI", {0xE, INST_TYPE_B}},
+            {"SHF", {0xF, INST_TYPE_C}},
+            {"AND", {0x10, INST_TYPE_A}},
+            {"OR", {0x11, INST_TYPE_A}},
+            {"XOR", {0x12, INST_TYPE_A}},
+            {"NOT", {0x13, INST_TYPE_A}},
+            {"BRN", {0x14, INST_TYPE_C}},
+            {"JUMP", {0x15, INST_TYPE_D}},
+            {"SUBJ", {0x16, INST_TYPE_D}},
+            {"RDCTR", {0x17, INST_TYPE_D}},
+            {"RSTCTR", {0x18, INST_TYPE_D}},
+            {"VLOAD", {0x19, INST_TYPE_A}},
+            {"VSTR", {0x1A, INST_TYPE_A}},
+            {"VADD", {0x1B, INST_TYPE_A}},
+            {"VMUL", {0x1C, INST_TYPE_A}},
+            {"VRED", {0x1D, INST_TYPE_B}},
+            {"HALT", {0xFF, INST_TYPE_HALT}}, // HALT is special instruction of all 1s
+        };
+        return table;
+    }
+
+    static int operandCount(int type) {
+        switch (type) {
+            case INST_TYPE_A: return 4;
+            case INST_TYPE_B: return 3;
+            case INST_TYPE_C: return 4;
+            case INST_TYPE_D: return 2;
+            default: return 0;
+        }
+    }
+
+    // splits on whitespace, everything from a token starting with # onwards is a comment
+    static vector<string> tokenize(const string& text, size_t begin, size_t end) {
+        vector<string> tokens;
+        size_t i = begin;
+        while (i < end) {
+            while (i < end && isspace((unsigned char)text[i])) i++;
+            if (i >= end || text[i] == '#') break;
+            size_t start = i;
+            while (i < end && !isspace((unsigned char)text[i])) i++;
+            tokens.push_back(text.substr(start, i - start));
+        }
+        return tokens;
+    }
+
+    static vector<SourceLine> splitLines(const string& source) {
+        vector<SourceLine> lines;
+        size_t pos = 0;
+        int line_number = 1;
+        while (pos < source.size()) {
+            size_t end = source.find('\n', pos);
+            if (end == string::npos) end = source.size();
+            vector<string> tokens = tokenize(source, pos, end);
+            if (!tokens.empty()) lines.push_back({line_number, tokens});
+            pos = end + 1;
+            line_number++;
+        }
+        return lines;
+    }
+
+    // same rules as Integer.parseInt(token, 16): optional sign, hex digits, no 0x prefix
+    static bool parseHex(const string& token, long long& value) {
+        size_t i = (token[0] == '-' || token[0] == '+') ? 1 : 0;
+        if (i == token.size() || token.size() - i > 8) return false;
+        for (size_t j = i; j < token.size(); j++)
+            if (!isxdigit((unsigned char)token[j])) return false;
+        value = strtoll(token.c_str(), nullptr, 16);
+        return true;
+    }
+
+    static bool parseDecimal(const string& token, long long& value) {
+        size_t i = (token[0] == '-' || token[0] == '+') ? 1 : 0;
+        if (i == token.size() || token.size() - i > 10) return false;
+        for (size_t j = i; j < token.size(); j++)
+            if (!isdigit((unsigned char)token[j])) return false;
+        value = strtoll(token.c_str(), nullptr, 10);
+        return true;
+    }
+
+    static string errorAt(int line_number, const string& message) {
+        return "line " + to_string(line_number) + ": " + message;
+    }
+
+    // resolves a symbol or hex literal and checks that it fits in a field of the given width
+    // immediates may be written signed or unsigned, registers and conditions must be unsigned
+    static bool getOperand(const string& token, const unordered_map<string, int>& symbols, int bits,
+                           bool allow_negative, int line_number, vector<string>& errors, unsigned int& field) {
+        long long value;
+        auto symbol = symbols.find(token);
+        if (symbol != symbols.end()) {
+            value = symbol->second;
+        } else if (!parseHex(token, value)) {
+            errors.push_back(errorAt(line_number, "undefined symbol or invalid hex number '" + token + "'"));
+            return false;
+        }
+        long long max = (1LL << bits) - 1;
+        long long min = allow_negative ? -(1LL << (bits - 1)) : 0;
+        if (value < min || value > max) {
+            errors.push_back(errorAt(line_number, "operand '" + token + "' does not fit in " + to_string(bits) + " bits"));
+            return false;
+        }
+        field = (unsigned int)value & (unsigned int)max;
+        return true;
+    }
+
+    static bool encode(const Mnemonic& inst, const vector<string>& operands, const unordered_map<string, int>& symbols,
+                       int line_number, vector<string>& errors, unsigned int& encoded) {
+        unsigned int opcode = inst.opcode;
+        unsigned int r0 = 0, r1 = 0, r2 = 0, cond = 0, imm = 0;
+        bool ok = true;
+        switch (inst.type) {
+            case INST_TYPE_A:
+                ok &= getOperand(operands[0], symbols, 4, false, line_number, errors, r0);
+                ok &= getOperand(operands[1], symbols, 4, false, line_number, errors, r1);
+                ok &= getOperand(operands[2], symbols, 4, false, line_number, errors, r2);
+                ok &= getOperand(operands[3], symbols, 15, true, line_number, errors, imm);
+                encoded = opcode << 27 | r0 << 23 | r1 << 19 | r2 << 15 | imm;
+                break;
+            case INST_TYPE_B:
+                ok &= getOperand(operands[0], symbols, 4, false, line_number, errors, r0);
+                ok &= getOperand(operands[1], symbols, 4, false, line_number, errors, r1);
+                ok &= getOperand(operands[2], symbols, 19, true, line_number, errors, imm);
+                encoded = opcode << 27 | r0 << 23 | r1 << 19 | imm;
+                break;
+            case INST_TYPE_C:
+                ok &= getOperand(operands[0], symbols, 4, false, line_number, errors, r0);
+                ok &= getOperand(operands[1], symbols, 4, false, line_number, errors, r1);
+                ok &= getOperand(operands[2], symbols, 2, false, line_number, errors, cond);
+                ok &= getOperand(operands[3], symbols, 17, true, line_number, errors, imm);
+                encoded = opcode << 27 | r0 << 23 | r1 << 19 | cond << 17 | imm;
+                break;
+            case INST_TYPE_D:
+                ok &= getOperand(operands[0], symbols, 4, false, line_number, errors, r0);
+                ok &= getOperand(operands[1], symbols, 23, true, line_number, errors, imm);
+                encoded = opcode << 27 | r0 << 23 | imm;
+                break;
+            default:
+                encoded = 0xFFFFFFFF;
+        }
+        // a vector register field could hold up to 15, but only V0..V7 exist
+        unsigned int fields[] = {r0, r1, r2};
+        for (int i = 0; i < 3; i++) {
+            if ((vectorRegisterFields(opcode) >> i & 1) && fields[i] >= NUM_VECTOR_REGISTERS) {
+                errors.push_back(errorAt(line_number, "operand '" + operands[i] + "' is not a vector register (V0..V7)"));
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+public:
+    // which register fields of an opcode name vector registers: bit 0 for r0, bit 1 for r1, bit 2 for r2
+    static int vectorRegisterFields(int opcode) {
+        switch (opcode) {
+            case 0x19: case 0x1A: return 1; // VLOAD Vd Rb Ri imm, VSTR Vs Rb Ri imm
+            case 0x1B: case 0x1C: return 7; // VADD/VMUL Vd Va Vb
+            case 0x1D: return 2;            // VRED Rd Va
+            default: return 0;
+        }
+    }
+
+    // opcode of a mnemonic (upper case), or -1 if there is none
+    static int opcodeOf(const string& mnemonic) {
+        auto found = mnemonicTable().find(mnemonic);
+        return found == mnemonicTable().end() ? -1 : found->second.opcode;
+    }
+
+    static AssemblyResult assemble(const string& source) {
+        const unordered_map<string, Mnemonic>& mnemonics = mnemonicTable();
+        AssemblyResult result;
+        vector<SourceLine> lines = splitLines(source);
+
+        unordered_map<string, int> symbols;
+        for (int i = 0; i < 16; i++)
+            symbols["R" + to_string(i)] = i;
+        for (int i = 0; i < NUM_VECTOR_REGISTERS; i++)
+            symbols["V" + to_string(i)] = i;
+
+        // first pass, generate symbol table
+        // a token at the start of a line that is not a mnemonic declares a symbol for the current location
+        int cur_location = 0;
+        for (const SourceLine& line : lines) {
+            if (!mnemonics.count(line.tokens[0])) symbols.emplace(line.tokens[0], cur_location);
+            // for now, only considering instructions and not pseudo ops, so just increment location by one
+            cur_location++;
+        }
+
+        // second pass, generate instructions
+        result.words.reserve(lines.size());
+        cur_location = 0;
+        for (const SourceLine& line : lines) {
+            size_t first = mnemonics.count(line.tokens[0]) ? 0 : 1;
+            if (first == 1 && symbols[line.tokens[0]] != cur_location)
+                result.errors.push_back(errorAt(line.line_number, "symbol '" + line.tokens[0] + "' is already defined"));
+            cur_location++;
+
+            if (first >= line.tokens.size()) {
+                result.errors.push_back(errorAt(line.line_number, "symbol '" + line.tokens[0] + "' is not followed by an instruction"));
+                continue;
+            }
+
+            auto found = mnemonics.find(line.tokens[first]);
+            if (found == mnemonics.end()) {
+                string message = "unknown mnemonic '" + line.tokens[first] + "'";
+                if (first == 1) message += " after symbol '" + line.tokens[0] + "'";
+                result.errors.push_back(errorAt(line.line_number, message));
+                continue;
+            }
+
+            int needed = operandCount(found->second.type);
+            if ((int)(line.tokens.size() - first - 1) < needed) {
+                result.errors.push_back(errorAt(line.line_number, found->first + " expects " + to_string(needed) + " operands"));
+                continue;
+            }
+
+            // anything after the expected operands is ignored
+            vector<string> operands(line.tokens.begin() + first + 1, line.tokens.begin() + first + 1 + needed);
+            unsigned int encoded = 0;
+            if (encode(found->second, operands, symbols, line.line_number, result.errors, encoded))
+                result.words.push_back(encoded);
+        }
+
+        if (!result.ok()) result.words.clear();
+        return result;
+    }
+
+    // a program image is what Assembler.java writes: one signed decimal word per line
+    static bool isImage(const string& source) {
+        istringstream in(source);
+        string token;
+        long long value;
+        while (in >> token)
+            if (!parseDecimal(token, value)) return false;
+        return true;
+    }
+
+    static AssemblyResult parseImage(const string& source) {
+        AssemblyResult result;
+        istringstream in(source);
+        string token;
+        long long value;
+        int word = 0;
+        while (in >> token) {
+            if (!parseDecimal(token, value) || value < -2147483648LL || value > 4294967295LL) {
+                result.errors.push_back("word " + to_string(word) + ": invalid value '" + token + "'");
+                continue;
+            }
+            result.words.push_back((unsigned int)value);
+            word++;
+        }
+        return result;
+    }
+
+    // loads either an assembled image or assembly source, whichever the file contains
+    static AssemblyResult loadProgramFile(const string& filename) {
+        ifstream infile(filename);
+        if (!infile) {
+            AssemblyResult result;
+            result.errors.push_back("cannot open " + filename);
+            return result;
+        }
+        stringstream buffer;
+        buffer << infile.rdbuf();
+        string source = buffer.str();
+        return isImage(source) ? parseImage(source) : assemble(source);
+    }
+
+    static void writeImage(ostream& out, const vector<unsigned int>& words) {
+        for (unsigned int word : words)
+            out << (int)word << "\n";
+    }
+};
@@ -1,9 +1,15 @@
+#pragma once
 #include <iostream>
 #include <vector>
 #include <fstream>
 #include <iomanip>
 #include <string>
+#include <algorithm>
+#include <deque>
 #include "memoryUI.cpp"
+#include "assembler.cpp"
+#include "breakpoints.cpp"
+#include "functionalunits.cpp"
 
 using namespace std;
 
@@ -18,6 +24,41 @@ constexpr int TYPE_CONTROL = 1;
 constexpr int TYPE_MEMORY = 2;
 constexpr int FLAG_HALT = 1;
 constexpr int FLAG_RUNNING = 0;
+constexpr int FLAG_BREAK = 2; // run() stopped on a breakpoint or watchpoint
+
+// performance counters, read with RDCTR Rd <index> and cleared with RSTCTR R0 <index>
+constexpr int OPCODE_RDCTR = 23;
+constexpr int OPCODE_RSTCTR = 24;
+constexpr int CTR_CYCLES = 0;
+constexpr int CTR_INSTRUCTIONS = 1;
+constexpr int CTR_CACHE_HITS = 2;
+constexpr int CTR_CACHE_MISSES = 3;
+constexpr int CTR_STALL_CYCLES = 4;
+constexpr int CTR_BRANCH_FLUSHES = 5;
+constexpr int NUM_PERF_COUNTERS = 6;
+constexpr int CTR_ALL = 0xF; // RSTCTR only, clears every counter
+
+// optional fetch unit, see setFetchUnit()
+constexpr int FETCH_QUEUE_LINES = 2;
+constexpr int LOOP_BUFFER_SIZE = 16;                 // longest loop body (in words) the loop buffer holds
+
+// packed vector extension: V0..V7 hold VECTOR_WIDTH words each, one cache line, so VLOAD and VSTR
+// move a whole (aligned) line in a single memory access
+constexpr int OPCODE_VLOAD = 25;
+constexpr int OPCODE_VSTR = 26;
+constexpr int OPCODE_VADD = 27;
+constexpr int OPCODE_VMUL = 28;
+constexpr int OPCODE_VRED = 29;                       // sums the elements of a vector into a scalar register
+constexpr int VECTOR_WIDTH = WORDS_PER_LINE;
+
+// whether every vector register field of word names one of V0..V7 (NUM_VECTOR_REGISTERS is in assembler.cpp);
+// the fields are 4 bits wide, so a data word or hand-written image can name V8..V15, which decodes as a NOP
+inline bool vectorRegistersValid(unsigned int word) {
+    int fields = Assembler::vectorRegisterFields((word & 0xF8000000) >> 27);
+    for (int i = 0; i < 3; i++)
+        if ((fields >> i & 1) && (int)(word >> (23 - 4 * i) & 0xF) >= NUM_VECTOR_REGISTERS) return false;
+    return true;
+}
 
 struct Instruction {
     int addr = -1;
@@ -31,25 +72,75 @@ struct Instruction {
     int result = -1;
     int writeback_val = -1;
     int target = -1;
+    int vtarget = -1, vs1 = -1, vs2 = -1; // vector register fields, -1 if unused
+    int vec_a[VECTOR_WIDTH] = {};        // vector operands, vec_a also carries the vector result
+    int vec_b[VECTOR_WIDTH] = {};
     bool has_writeback = false;
+    int complete_cycle = 0;              // first cycle WRITEBACK can retire it, set when it issues to a functional unit
     bool hazard = false;
     bool stall = false;
     bool is_empty = true;
 };
 
-class Simulator {
+// PipelinePolicy and CachePolicy are RuntimeFlag or Fixed<bool> (see memoryUI.cpp), the geometry is the cache's
+template <class PipelinePolicy, class CachePolicy, int Lines = CACHE_LINES, int LineWords = WORDS_PER_LINE>
+class BasicSimulator {
+    static_assert(LineWords % VECTOR_WIDTH == 0, "a vector access has to stay within one cache line");
+
 private:
     vector<int> registers;
+    vector<int> vector_registers = vector<int>(NUM_VECTOR_REGISTERS * VECTOR_WIDTH, 0);
     int program_counter;
-    MemorySystem memory_system;
+    BasicMemorySystem<CachePolicy, Lines, LineWords> memory_system;
     int cycle_count = 0;
     bool pipeline_halted = false;
     int instruction_count = 0;
+    int stall_cycles = 0;
+    int branch_flushes = 0;
+    bool stalled = false; // whether any stage stalled in the last step
+
+    // RSTCTR doesn't touch the host-visible totals, it just moves the point software counts from
+    vector<int> perf_counter_base = vector<int>(NUM_PERF_COUNTERS, 0);
+    // values RDCTR retired with, in order, kept only while recordCounterReads() is on
+    bool recording_counter_reads = false;
+    vector<int> counter_reads;
 
     vector<Instruction> pipeline = vector<Instruction>(5);
 
-    bool use_pipeline;
+    PipelinePolicy use_pipeline;
     bool keep_fetching = true;
+    bool progressed = false; // whether the last step moved, retired or fetched anything
+
+    vector<string> load_errors;
+
+    FunctionalUnitPool functional_units;
+    int structural_stall_type = -1; // unit type EXECUTE waited for in the last step, -1 if none
+
+    BreakpointTable breakpoints = BreakpointTable(NUM_REGISTERS);
+    bool break_hit = false;
+    string break_reason;
+
+    // fetch queue: whole lines are read ahead of the FETCH stage into the words at
+    // [queue_head, queue_head + fetch_queue.size()), and FETCH takes instructions from there
+    bool use_fetch_queue = false;
+    deque<unsigned int> fetch_queue;
+    int queue_head = 0;
+    int line_request = -1;           // address whose line is being read into the queue, -1 if none
+    bool line_request_stale = false; // redirected or overwritten while in flight, dropped when it completes
+    vector<int> line_words;
+    vector<int> vector_line;         // line read by a VLOAD
+    long long queue_occupancy_sum = 0;
+    int queue_fetches = 0;
+    int line_fetches = 0;
+
+    // loop buffer: a short loop closed by a taken backward branch is captured from the recently
+    // fetched words and replayed without going to the memory system until a store hits it
+    bool use_loop_buffer = false;
+    vector<pair<int, unsigned int>> recent_fetches = vector<pair<int, unsigned int>>(2 * LOOP_BUFFER_SIZE, {-1, 0});
+    int loop_start = -1, loop_end = -1; // inclusive, -1 when empty
+    vector<unsigned int> loop_words;
+    int loop_buffer_hits = 0;
+    int loops_captured = 0;
 
     char getInstType(int opcode) {
         switch (opcode) { // uses fallthrough intentionally
@@ -75,7 +166,14 @@ private:
             case 3:
             case 4:
             case 21:
-            case 22: return 'D';
+            case 22:
+            case 23:
+            case 24: return 'D';
+            case 25:
+            case 26:
+            case 27:
+            case 28:
+            case 29: return 'V';
             default: return 'X'; // unrecognized instruction, treat as NOP
         }
     }
@@ -108,44 +206,121 @@ private:
             case 9: return "MUL";
             case 20: return "BRN";
             case 21: return "JUMP";
+            case 23: return "RDCTR";
+            case 24: return "RSTCTR";
+            case OPCODE_VLOAD: return "VLOAD";
+            case OPCODE_VSTR: return "VSTR";
+            case OPCODE_VADD: return "VADD";
+            case OPCODE_VMUL: return "VMUL";
+            case OPCODE_VRED: return "VRED";
             default: return "NOP";
         }
     }
 
 public:
-    Simulator(bool pipe = true, bool cache = true)
+    BasicSimulator(bool pipe = true, bool cache = true)
         : registers(NUM_REGISTERS, 0), program_counter(0),
           use_pipeline(pipe), memory_system(cache) {}
 
-    void loadProgramFromFile(const string& filename) {
-        ifstream infile(filename);
-        unsigned int instr;
-        int addr = 0;
-        while (infile >> instr) {
-            memory_system.forceWrite(addr, instr);
-            addr++;
-        }
-        program_counter = 0;
+    // accepts either assembly source or an image produced by the assembler
+    // returns false and leaves the simulator untouched if the file has errors, see getLoadErrors()
+    bool loadProgramFromFile(const string& filename) {
+        AssemblyResult program = Assembler::loadProgramFile(filename);
+        load_errors = program.errors;
+        if (!program.ok()) return false;
+        loadProgram(program.words);
+        return true;
+    }
+
+    void loadProgram(const vector<unsigned int>& words) {
+        for (int addr = 0; addr < (int)words.size() && addr < RAM_SIZE; addr++)
+            memory_system.forceWrite(addr, words[addr]);
+        resetExecution(0);
+    }
+
+    // starts from a saved architectural state instead of a program image (used by sampled simulation)
+    // vregs holds the vector registers one after the other, left as they are if empty
+    void loadState(const vector<int>& regs, const vector<int>& memory, int pc, const vector<int>& vregs = vector<int>()) {
+        for (int addr = 0; addr < (int)memory.size() && addr < RAM_SIZE; addr++)
+            memory_system.forceWrite(addr, memory[addr]);
+        registers = regs;
+        if (vregs.size() == vector_registers.size()) vector_registers = vregs;
+        resetExecution(pc);
+    }
+
+    // functional cache warm-up before a detailed sample, see MemorySystem::warm
+    void warmCache(int address, bool write) { memory_system.warm(address, write); }
+
+    void resetExecution(int pc) {
+        program_counter = pc;
         pipeline = vector<Instruction>(5);
         cycle_count = 0;
         instruction_count = 0;
+        stall_cycles = 0;
+        branch_flushes = 0;
+        perf_counter_base = vector<int>(NUM_PERF_COUNTERS, 0);
+        counter_reads.clear();
+        memory_system.resetDma();
+        functional_units.reset();
+
+        fetch_queue.clear();
+        queue_head = pc;
+        line_request = -1;
+        queue_occupancy_sum = 0;
+        queue_fetches = 0;
+        line_fetches = 0;
+        fill(recent_fetches.begin(), recent_fetches.end(), make_pair(-1, 0u));
+        loop_start = loop_end = -1;
+        loop_buffer_hits = 0;
+        loops_captured = 0;
+    }
+
+    // latencies, initiation intervals and unit counts for EXECUTE, FunctionalUnitConfig::singleCycle() by default
+    void setFunctionalUnits(const FunctionalUnitConfig& config) {
+        functional_units.configure(config);
+        resetExecution(program_counter);
+    }
+
+    // fully associative victim cache behind the data/instruction cache, entries 0 (the default) is off
+    void setVictimCache(int entries, int latency = VICTIM_DELAY) { memory_system.setVictimCache(entries, latency); }
+
+    // one of DMA_POLICY_*, how the DMA engine and the pipeline share the memory port
+    void setDmaPolicy(int policy) { memory_system.setDmaPolicy(policy); }
+
+    // both off by default, which keeps the original one-word-per-access fetch timing
+    void setFetchUnit(bool fetch_queue_on, bool loop_buffer_on) {
+        use_fetch_queue = fetch_queue_on;
+        use_loop_buffer = loop_buffer_on;
+        resetExecution(program_counter);
     }
 
     int step() {
+        progressed = false;
+        structural_stall_type = -1;
+        memory_system.dmaStartOfCycle();
+        for (int address : memory_system.takeDmaWrites()) invalidateFetch(address);
         if (!pipeline[STAGE_WRITEBACK].is_empty) {
-            if (writeback(pipeline[STAGE_WRITEBACK]) == FLAG_HALT)
-                return FLAG_HALT;
-            pipeline[STAGE_WRITEBACK].is_empty = true;
-            keep_fetching = true;
+            if (pipeline[STAGE_WRITEBACK].complete_cycle > cycle_count) {
+                pipeline[STAGE_WRITEBACK].stall = true; // result still in its functional unit
+            } else {
+                if (writeback(pipeline[STAGE_WRITEBACK]) == FLAG_HALT)
+                    return FLAG_HALT;
+                pipeline[STAGE_WRITEBACK].is_empty = true;
+                keep_fetching = true;
+                progressed = true;
+            }
         }
 
         if (!pipeline[STAGE_MEMORY].is_empty) {
             pipeline[STAGE_MEMORY].stall = false;
-            if (pipeline[STAGE_WRITEBACK].is_empty) {
+            // a load or store can't start before its address is out of the ALU
+            bool address_ready = pipeline[STAGE_MEMORY].type != TYPE_MEMORY || pipeline[STAGE_MEMORY].complete_cycle - 1 <= cycle_count;
+            if (pipeline[STAGE_WRITEBACK].is_empty && address_ready) {
                 Instruction res = memory(pipeline[STAGE_MEMORY]);
                 if (!res.hazard)  {
                     pipeline[STAGE_WRITEBACK] = res;
                     pipeline[STAGE_MEMORY].is_empty = true;
+                    progressed = true;
                 } else {
                     pipeline[STAGE_MEMORY].stall = true;
                 }
@@ -161,6 +336,7 @@ public:
                 if (!res.hazard) {
                     pipeline[STAGE_MEMORY] = res;
                     pipeline[STAGE_EXECUTE].is_empty = true;
+                    progressed = true;
                 } else {
                     pipeline[STAGE_EXECUTE].stall = true;
                 }
@@ -176,6 +352,7 @@ public:
                 if (!res.hazard) {
                     pipeline[STAGE_EXECUTE] = res;
                     pipeline[STAGE_DECODE].is_empty = true;
+                    progressed = true;
                 } else {
                     pipeline[STAGE_DECODE].stall = true;
                 }
@@ -184,6 +361,8 @@ public:
             }
         }
 
+        runFetchUnit();
+
         if (!pipeline[STAGE_FETCH].is_empty) { 
             pipeline[STAGE_FETCH].stall = false;
             if (pipeline[STAGE_DECODE].is_empty) {
@@ -191,6 +370,7 @@ public:
                 if (!res.hazard) {
                     pipeline[STAGE_DECODE] = res;
                     pipeline[STAGE_FETCH].is_empty = true;
+                    progressed = true;
                 } else {
                     pipeline[STAGE_FETCH].stall = true;
                 }
@@ -204,9 +384,12 @@ public:
             inst.addr = program_counter;
             inst.is_empty = false;
             pipeline[STAGE_FETCH] = inst;
-            if (!use_pipeline) keep_fetching = false;
+            if (!use_pipeline()) keep_fetching = false;
+            progressed = true;
         }
 
+        memory_system.dmaEndOfCycle();
+
         // check if the simulation is halted and the pipeline is fully drained (to prevent infinite loop for run to end)
         bool all_stages_empty = true;
         for (const auto& stage : pipeline) {
@@ -216,14 +399,172 @@ public:
             }
         }
         
-        if (pipeline_halted && all_stages_empty) {
+        // HALT also waits for a DMA transfer to finish
+        if (pipeline_halted && all_stages_empty && !memory_system.dmaActive()) {
             return FLAG_HALT;
         }
 
+        stalled = false;
+        for (const auto& stage : pipeline)
+            stalled |= !stage.is_empty && stage.stall;
+        if (stalled) stall_cycles++;
+        queue_occupancy_sum += fetch_queue.size();
+
         cycle_count++;
         return FLAG_RUNNING;
     }
 
+    // runs up to max_cycles cycles, same results as calling step() that many times
+    // when a step changes nothing but the countdown of an in-flight memory access, every cycle until
+    // that access completes would do the same, so those cycles are skipped in one go
+    // returns FLAG_BREAK after the cycle in which a breakpoint or watchpoint fired, see getBreakReason()
+    int run(int max_cycles) {
+        long long end_cycle = (long long)cycle_count + max_cycles;
+        break_hit = false;
+        memory_system.clearWatchHit();
+        while (cycle_count < end_cycle) {
+            int pending = memory_system.pendingCycles();
+            if (step() == FLAG_HALT) return FLAG_HALT;
+            if (break_hit || memory_system.hasWatchHit()) return stopAtBreak();
+            // DMA transfers change memory every few cycles, so nothing is skipped while one runs
+            if (!progressed && pending > 0 && memory_system.pendingCycles() == pending - 1 && !memory_system.dmaActive())
+                skipStalledCycles(end_cycle - cycle_count);
+        }
+        return FLAG_RUNNING;
+    }
+
+    int stopAtBreak() {
+        if (!break_hit) {
+            break_hit = true;
+            break_reason = string(memory_system.getWatchKind() == WATCH_READ ? "read of [" : "write to [") +
+                           to_string(memory_system.getWatchAddress()) + "], value " + to_string(memory_system.getWatchValue());
+        }
+        return FLAG_BREAK;
+    }
+
+    // unconditional PC breakpoints are only looked at when the PC changes; conditional ones wait until the
+    // instruction retires (see writeback()), since with the pipeline on older instructions may not have written back yet
+    void checkBreakpoint() {
+        if (!break_hit && breakpoints.hasBreakpoint(program_counter)) {
+            break_hit = true;
+            break_reason = "breakpoint at PC " + to_string(program_counter);
+        }
+    }
+
+    // replaces all breakpoints and watchpoints, see BreakpointTable::parse for the syntax
+    bool setBreakpoints(const string& spec, string& error) {
+        breakpoints.clear();
+        memory_system.clearWatches();
+        vector<MemoryWatch> watches;
+        if (!breakpoints.parse(spec, watches, error)) {
+            breakpoints.clear();
+            return false;
+        }
+        for (const MemoryWatch& watch : watches)
+            memory_system.watch(watch.low, watch.high, watch.kinds);
+        return true;
+    }
+
+    void skipStalledCycles(long long limit) {
+        // the access completes on the call that takes the countdown to 0, that cycle still has to run
+        long long skip = min((long long)memory_system.pendingCycles() - 1, limit);
+        // so does the first cycle in which a functional unit finishes or frees up for a waiting instruction
+        skip = min(skip, (long long)nextUnitEvent() - cycle_count);
+        if (skip <= 0) return;
+        memory_system.skipCycles((int)skip);
+        cycle_count += (int)skip;
+        if (stalled) stall_cycles += (int)skip;
+        if (structural_stall_type != -1) functional_units.addStructuralStalls(structural_stall_type, (int)skip);
+        queue_occupancy_sum += fetch_queue.size() * skip;
+    }
+
+    // only called after a step that moved nothing, so an instruction in WRITEBACK is waiting for its result
+    int nextUnitEvent() const {
+        int next = structural_stall_type != -1 ? functional_units.nextFreeCycle(cycle_count - 1) : INT_MAX;
+        const Instruction& writeback_inst = pipeline[STAGE_WRITEBACK];
+        if (!writeback_inst.is_empty && writeback_inst.complete_cycle >= cycle_count) next = min(next, writeback_inst.complete_cycle);
+        const Instruction& memory_inst = pipeline[STAGE_MEMORY];
+        if (!memory_inst.is_empty && memory_inst.type == TYPE_MEMORY && memory_inst.complete_cycle - 1 >= cycle_count)
+            next = min(next, memory_inst.complete_cycle - 1);
+        return next;
+    }
+
+    int queueEnd() const { return queue_head + (int)fetch_queue.size(); }
+
+    void flushFetchQueue(int address) {
+        fetch_queue.clear();
+        queue_head = address;
+        if (line_request != -1) line_request_stale = true;
+    }
+
+    bool loopBufferHolds(int address) const {
+        return use_loop_buffer && address >= loop_start && address <= loop_end && loop_start != -1;
+    }
+
+    // runs once per cycle before the FETCH stage, after MEM, so MEM wins when both want an idle memory
+    void runFetchUnit() {
+        if (!use_fetch_queue) return;
+
+        // the address FETCH wants next; anything the queue holds before it is dead, and if the queue
+        // doesn't reach it at all FETCH was redirected
+        int wanted = pipeline[STAGE_FETCH].is_empty ? program_counter : pipeline[STAGE_FETCH].addr;
+        if (wanted < queue_head || wanted > queueEnd()) {
+            flushFetchQueue(wanted);
+        } else {
+            while (queue_head < wanted) {
+                fetch_queue.pop_front();
+                queue_head++;
+            }
+        }
+
+        // an access has to be followed through to the end once started
+        if (line_request != -1) {
+            if (memory_system.readLine(line_request, STAGE_FETCH, line_words).status != STATUS_DONE) return;
+            line_fetches++;
+            int base = line_request / LineWords * LineWords;
+            if (!line_request_stale && line_request == queueEnd()) {
+                for (int address = line_request; address < base + LineWords; address++)
+                    fetch_queue.push_back(line_words[address - base]);
+            }
+            line_request = -1;
+            return;
+        }
+
+        // while a loop replays from the loop buffer the memory is left to the MEM stage
+        if (loopBufferHolds(wanted) || pipeline_halted || memory_system.pendingCycles() > 0) return;
+        int end = queueEnd();
+        int words = LineWords - end % LineWords;
+        if (end < 0 || end >= RAM_SIZE || (int)fetch_queue.size() + words > FETCH_QUEUE_LINES * LineWords) return;
+        line_request = end;
+        line_request_stale = false;
+        memory_system.readLine(end, STAGE_FETCH, line_words);
+    }
+
+    // called on a taken branch or jump, captures the loop if its whole body was fetched recently
+    void captureLoop(int branch_addr, int target) {
+        if (!use_loop_buffer || target > branch_addr || branch_addr - target >= LOOP_BUFFER_SIZE) return;
+        if (target == loop_start && branch_addr == loop_end) return;
+        vector<unsigned int> words;
+        for (int address = target; address <= branch_addr; address++) {
+            const pair<int, unsigned int>& recent = recent_fetches[address % recent_fetches.size()];
+            if (recent.first != address) return;
+            words.push_back(recent.second);
+        }
+        loop_start = target;
+        loop_end = branch_addr;
+        loop_words = words;
+        loops_captured++;
+    }
+
+    // a store to an instruction the fetch unit holds makes it refetch from memory
+    void invalidateFetch(int address) {
+        if (address >= queue_head && address < queueEnd()) flushFetchQueue(queue_head);
+        if (line_request != -1 && address / LineWords == line_request / LineWords) line_request_stale = true;
+        if (address >= loop_start && address <= loop_end) loop_start = loop_end = -1;
+        pair<int, unsigned int>& recent = recent_fetches[address % recent_fetches.size()];
+        if (recent.first == address) recent.first = -1;
+    }
+
     Instruction fetch(Instruction inst) {
         if (inst.is_empty) return inst;
     
@@ -235,27 +576,47 @@ public:
             return halt_inst;
         }
     
-        MemoryResult res = memory_system.read(inst.addr, STAGE_FETCH);
-        if (res.status == STATUS_DONE) {
-            Instruction new_inst;
-            new_inst.binary = res.value;
-            new_inst.addr = inst.addr;
-    
-            if (res.value == -1) {
-                // treat -1 (invalid instruction) as HALT signal
-                pipeline_halted = true;
-                new_inst.is_empty = true;
-            } else {
-                new_inst.is_empty = false;
-                program_counter++;
+        unsigned int binary;
+        // a word read FETCH already started (before a redirect into the loop) still has to finish first
+        if (loopBufferHolds(inst.addr) && !memory_system.busyFor(STAGE_FETCH)) {
+            binary = loop_words[inst.addr - loop_start];
+            loop_buffer_hits++;
+        } else if (use_fetch_queue) {
+            if (fetch_queue.empty() || queue_head != inst.addr) {
+                cout << "fetch for instruction " << inst.addr << " waiting for the fetch queue" << endl;
+                inst.hazard = true;
+                return inst;
             }
-    
-            return new_inst;
+            binary = fetch_queue.front();
+            fetch_queue.pop_front();
+            queue_head++;
+            queue_fetches++;
         } else {
-            cout << "fetch for instruction " << inst.addr << " missed cache, waiting for RAM" << endl;
-            inst.hazard = true;
-            return inst;
+            MemoryResult res = memory_system.read(inst.addr, STAGE_FETCH);
+            if (res.status != STATUS_DONE) {
+                cout << "fetch for instruction " << inst.addr << " missed cache, waiting for RAM" << endl;
+                inst.hazard = true;
+                return inst;
+            }
+            binary = res.value;
+        }
+        if (use_loop_buffer) recent_fetches[inst.addr % recent_fetches.size()] = {inst.addr, binary};
+
+        Instruction new_inst;
+        new_inst.binary = binary;
+        new_inst.addr = inst.addr;
+
+        if (binary == (unsigned int)-1) {
+            // treat -1 (invalid instruction) as HALT signal
+            pipeline_halted = true;
+            new_inst.is_empty = true;
+        } else {
+            new_inst.is_empty = false;
+            program_counter++;
+            checkBreakpoint();
         }
+
+        return new_inst;
     }    
 
     Instruction decode(Instruction inst) {
@@ -322,11 +683,44 @@ public:
                     res.op1 = res.immediate;
                     res.type = TYPE_ALU;
                     res.has_writeback = true;
+                } else if (opcode == OPCODE_RDCTR) {
+                    // counter index stays in the immediate, there are no register operands
+                    res.target = res.r0;
+                    res.type = TYPE_ALU;
+                    res.has_writeback = true;
+                } else if (opcode == OPCODE_RSTCTR) {
+                    res.type = TYPE_CONTROL;
                 } else {
                     res.op1 = res.r0;
                     res.type = TYPE_CONTROL;
                 }
                 break;
+            case 'V':
+                // vector extension, register fields and immediate laid out as in type A
+                // VLOAD Vd Rb Ri imm, VSTR Vs Rb Ri imm, VADD/VMUL Vd Va Vb, VRED Rd Va
+                res.r0 = (inst.binary & 0x07800000) >> 23;
+                res.r1 = (inst.binary & 0x00780000) >> 19;
+                res.r2 = (inst.binary & 0x00078000) >> 15;
+                res.immediate = inst.binary & 0x00007FFF;
+                if (!vectorRegistersValid(inst.binary)) break; // no operands or results, like an unrecognized opcode
+                if (opcode == OPCODE_VLOAD || opcode == OPCODE_VSTR) {
+                    res.type = TYPE_MEMORY;
+                    res.op1 = res.r1;
+                    res.op2 = res.r2;
+                    if (opcode == OPCODE_VLOAD) res.vtarget = res.r0;
+                    else res.vs1 = res.r0;
+                } else if (opcode == OPCODE_VRED) {
+                    res.type = TYPE_ALU;
+                    res.vs1 = res.r1;
+                    res.target = res.r0;
+                    res.has_writeback = true;
+                } else {
+                    res.type = TYPE_ALU;
+                    res.vs1 = res.r1;
+                    res.vs2 = res.r2;
+                    res.vtarget = res.r0;
+                }
+                break;
         }
 
         // handle dependencies
@@ -340,11 +734,21 @@ public:
                 res.is_empty = false;
                 return res;
             }
+            // vector registers are a separate file, checked the same way
+            if (!pipeline[i].is_empty && pipeline[i].vtarget != -1 && (pipeline[i].vtarget == res.vs1 || pipeline[i].vtarget == res.vs2)) {
+                cout << "instruction " << res.addr << "(" << getOperationName(res.opcode) << ")";
+                cout << " has dependency on instruction " << pipeline[i].addr <<"(" << getOperationName(pipeline[i].opcode) << ")" << endl;
+                res.hazard = true;
+                res.is_empty = false;
+                return res;
+            }
         }
         // no dependencies in pipe, fetch operands
-        if (opcode != 3) res.op1 = registers[res.op1]; // LOADI has only an immediate operand
-        if (inst_type == 'A' || inst_type == 'C') res.op2 = registers[res.op2];
+        if (opcode != 3 && res.op1 != -1) res.op1 = registers[res.op1]; // LOADI, RDCTR and RSTCTR have only an immediate operand
+        if (inst_type == 'A' || inst_type == 'C' || (inst_type == 'V' && res.op2 != -1)) res.op2 = registers[res.op2];
         if (res.op3 != -1) res.op3 = registers[res.op3];
+        if (res.vs1 != -1) copy_n(&vector_registers[res.vs1 * VECTOR_WIDTH], VECTOR_WIDTH, res.vec_a);
+        if (res.vs2 != -1) copy_n(&vector_registers[res.vs2 * VECTOR_WIDTH], VECTOR_WIDTH, res.vec_b);
 
         res.is_empty = false;
         return res;
@@ -352,6 +756,14 @@ public:
 
     Instruction execute(Instruction inst) {
         if (inst.is_empty) return inst;
+        if (!functional_units.issue(inst.opcode, cycle_count)) {
+            structural_stall_type = functional_units.unitType(inst.opcode);
+            cout << "instruction " << inst.addr << "(" << getOperationName(inst.opcode) << ")";
+            cout << " waiting for a free " << FunctionalUnitConfig::unitName(structural_stall_type) << " unit" << endl;
+            inst.hazard = true;
+            return inst;
+        }
+        inst.complete_cycle = cycle_count + functional_units.latency(inst.opcode) + 1;
         int res = 0;
 
         switch (inst.opcode) {
@@ -364,9 +776,30 @@ public:
             case 9: //mul 
                 res = (inst.op1 * inst.op2) & 0xFFFFFFFF; // discard upper bits
                 break;
+            case OPCODE_RDCTR: res = readPerfCounter(inst.immediate); break;
+            case OPCODE_RSTCTR: resetPerfCounter(inst.immediate); break;
+            case OPCODE_VLOAD: case OPCODE_VSTR: // aligned down to a whole vector
+                res = inst.op1 + inst.op2 + inst.immediate;
+                res -= res % VECTOR_WIDTH;
+                break;
+            case OPCODE_VADD: // element results go back into vec_a, same wraparound as the host
+                for (int i = 0; i < VECTOR_WIDTH; i++) inst.vec_a[i] = (int)((unsigned int)inst.vec_a[i] + (unsigned int)inst.vec_b[i]);
+                break;
+            case OPCODE_VMUL:
+                for (int i = 0; i < VECTOR_WIDTH; i++) inst.vec_a[i] = (int)((unsigned int)inst.vec_a[i] * (unsigned int)inst.vec_b[i]);
+                break;
+            case OPCODE_VRED: {
+                unsigned int sum = 0;
+                for (int i = 0; i < VECTOR_WIDTH; i++) sum += (unsigned int)inst.vec_a[i];
+                res = (int)sum;
+                break;
+            }
             case 20:
                 if (evaluateCond(inst.cond, inst.op1, inst.op2)) {
+                    branch_flushes++;
+                    captureLoop(inst.addr, inst.immediate);
                     program_counter = inst.immediate;
+                    checkBreakpoint();
                     // set all earlier stages to empty to squash pipe
                     Instruction emptyInst;
                     emptyInst.is_empty = true;
@@ -376,7 +809,10 @@ public:
                 }
                 break;
             case 21: //jump
+                branch_flushes++;
+                captureLoop(inst.addr, inst.op1);
                 program_counter = inst.op1;
+                checkBreakpoint();
                 // set all earlier stages to empty to squash pipe
                 Instruction emptyInst;
                 emptyInst.is_empty = true;
@@ -390,8 +826,31 @@ public:
         return inst;
     }
 
+    int getPerfCounter(int index) const {
+        switch (index) {
+            case CTR_CYCLES: return cycle_count;
+            case CTR_INSTRUCTIONS: return instruction_count;
+            case CTR_CACHE_HITS: return memory_system.getHits();
+            case CTR_CACHE_MISSES: return memory_system.getMisses();
+            case CTR_STALL_CYCLES: return stall_cycles;
+            case CTR_BRANCH_FLUSHES: return branch_flushes;
+            default: return 0;
+        }
+    }
+
+    int readPerfCounter(int index) const {
+        if (index < 0 || index >= NUM_PERF_COUNTERS) return 0;
+        return getPerfCounter(index) - perf_counter_base[index];
+    }
+
+    void resetPerfCounter(int index) {
+        for (int i = 0; i < NUM_PERF_COUNTERS; i++)
+            if (index == i || index == CTR_ALL) perf_counter_base[i] = getPerfCounter(i);
+    }
+
     Instruction memory(Instruction inst) {
         if (inst.is_empty || inst.type != TYPE_MEMORY) return inst;
+        if (inst.opcode == OPCODE_VLOAD || inst.opcode == OPCODE_VSTR) return vectorMemory(inst);
 
         if (inst.opcode == 0) {
             MemoryResult res = memory_system.read(inst.result, STAGE_MEMORY);
@@ -406,7 +865,10 @@ public:
             }
         } else {
             MemoryResult res = memory_system.write(inst.result, inst.op3, STAGE_MEMORY);
-            if (res.status == STATUS_DONE) return inst;
+            if (res.status == STATUS_DONE) {
+                invalidateFetch(inst.result);
+                return inst;
+            }
             inst.hazard = true;
             cout << "memory for instruction " << inst.addr << "(" << getOperationName(inst.opcode) << ")";
             cout << " missed cache, waiting for RAM" << endl;
@@ -414,10 +876,38 @@ public:
         }
     }
 
+    // VLOAD and VSTR take one access for the whole vector, timed like a single-word LOAD or STR
+    Instruction vectorMemory(Instruction inst) {
+        MemoryResult res;
+        if (inst.opcode == OPCODE_VLOAD) {
+            res = memory_system.readLine(inst.result, STAGE_MEMORY, vector_line);
+            if (res.status == STATUS_DONE)
+                copy_n(&vector_line[inst.result % LineWords], VECTOR_WIDTH, inst.vec_a);
+        } else {
+            res = memory_system.writeWords(inst.result, inst.vec_a, VECTOR_WIDTH, STAGE_MEMORY);
+            if (res.status == STATUS_DONE)
+                for (int i = 0; i < VECTOR_WIDTH; i++) invalidateFetch(inst.result + i);
+        }
+        if (res.status == STATUS_DONE) return inst;
+        cout << "memory for instruction " << inst.addr << "(" << getOperationName(inst.opcode) << ")";
+        cout << " missed cache, waiting for RAM" << endl;
+        inst.hazard = true;
+        return inst;
+    }
+
     int writeback(Instruction inst) { // why does this have a return value, it's always FLAG_RUNNING...
         if (inst.is_empty) return FLAG_RUNNING;
         if (inst.type == TYPE_ALU) inst.writeback_val = inst.result;
-        if (inst.has_writeback) registers[inst.r0] = inst.writeback_val;
+        if (!break_hit && breakpoints.hasConditionalBreakpoint(inst.addr))
+            break_hit = breakpoints.breakpointFires(inst.addr, registers, break_reason);
+        if (inst.has_writeback) {
+            registers[inst.r0] = inst.writeback_val;
+            if (!break_hit && breakpoints.watchesRegister(inst.r0))
+                break_hit = breakpoints.registerWatchFires(inst.r0, inst.writeback_val, break_reason);
+        }
+        if (inst.vtarget != -1) copy_n(inst.vec_a, VECTOR_WIDTH, &vector_registers[inst.vtarget * VECTOR_WIDTH]);
+        if (recording_counter_reads && inst.opcode == OPCODE_RDCTR) counter_reads.push_back(inst.writeback_val);
+        instruction_count++;
         return FLAG_RUNNING;
     }
 
@@ -433,6 +923,11 @@ public:
     void viewRegisters() {
         for (int i = 0; i < NUM_REGISTERS; i++)
             cout << "R" << setw(2) << i << ": " << registers[i] << "\n";
+        for (int i = 0; i < NUM_VECTOR_REGISTERS; i++) {
+            cout << "V" << setw(2) << i << ":";
+            for (int j = 0; j < VECTOR_WIDTH; j++) cout << " " << vector_registers[i * VECTOR_WIDTH + j];
+            cout << "\n";
+        }
     }
 
     // getters for Qt GUI
@@ -440,17 +935,72 @@ public:
     int getCycleCount() const { return cycle_count; }
     int getProgramCounter() const { return program_counter; }
     int viewRegister(int reg) const { return registers[reg]; }
+    int viewVectorElement(int reg, int element) const { return vector_registers[reg * VECTOR_WIDTH + element]; }
+    const vector<int>& getVectorRegisters() const { return vector_registers; }
     string getStageDisplayText(int stage) const { return getStageDisplay(pipeline[stage], stage); }
     int getInstructionCount() const { return instruction_count; }
     int getCacheHits() const { return memory_system.getHits(); }
     int getCacheMisses() const { return memory_system.getMisses(); }
+    int getStallCycles() const { return stall_cycles; }
+    int getBranchFlushes() const { return branch_flushes; }
+    const vector<string>& getLoadErrors() const { return load_errors; }
+    int readMemory(int address) const { return memory_system.peek(address); }
+    const string& getBreakReason() const { return break_reason; }
+    double getFetchQueueOccupancy() const { return cycle_count ? (double)queue_occupancy_sum / cycle_count : 0; }
+    int getQueueFetches() const { return queue_fetches; }
+    int getLineFetches() const { return line_fetches; }
+    int getLoopBufferHits() const { return loop_buffer_hits; }
+    int getLoopsCaptured() const { return loops_captured; }
+    const FunctionalUnitPool& getFunctionalUnits() const { return functional_units; }
+    int getVictimEntries() const { return memory_system.getVictimEntries(); }
+    int getVictimHits() const { return memory_system.getVictimHits(); }
+    int getVictimWriteHits() const { return memory_system.getVictimWriteHits(); }
+    int getVictimWritebacks() const { return memory_system.getVictimWritebacks(); }
+    int getDmaWords() const { return memory_system.getDmaWords(); }
+    long long getDmaPortCycles() const { return memory_system.getDmaPortCycles(); }
+    int getDmaConflicts() const { return memory_system.getDmaConflicts(); }
 
     void viewMemory (int level, int line) {
         return memory_system.view(level, line);
     }
+
+    // structured access for the UI, see MemorySystem::inspectCacheLine / inspectRam / trackChanges
+    CacheLineView inspectCacheLine(int line) const { return memory_system.inspectCacheLine(line); }
+    vector<int> inspectRam(int address, int count) const { return memory_system.inspectRam(address, count); }
+    void trackMemoryChanges(bool on) { memory_system.trackChanges(on); }
+
+    // for FunctionalSimulator::replayCounterReads, which has no timing model for most counters
+    void recordCounterReads(bool on) { recording_counter_reads = on; }
+    const vector<int>& getCounterReads() const { return counter_reads; }
+    vector<LineChange> takeMemoryChanges() { return memory_system.takeChanges(); }
+    int getCacheLineCount() const { return memory_system.getCacheLines(); }
+    int getLineWords() const { return memory_system.getLineWords(); }
 };
 
 
+// runtime-flag build used by the UI and most tools, for the specialized ones see dispatchSimulator()
+typedef BasicSimulator<RuntimeFlag, RuntimeFlag> Simulator;
+
+// constructs the variant specialized for the given modes and calls action(sim) with it, so the mode is
+// decided once here instead of on every stage and memory access; action is a functor with a
+// template <class Sim> int operator()(Sim& sim)
+template <class Action>
+int dispatchSimulator(bool pipeline, bool cache, Action& action) {
+    if (pipeline && cache) {
+        BasicSimulator<Fixed<true>, Fixed<true>> sim;
+        return action(sim);
+    } else if (pipeline) {
+        BasicSimulator<Fixed<true>, Fixed<false>> sim;
+        return action(sim);
+    } else if (cache) {
+        BasicSimulator<Fixed<false>, Fixed<true>> sim;
+        return action(sim);
+    } else {
+        BasicSimulator<Fixed<false>, Fixed<false>> sim;
+        return action(sim);
+    }
+}
+
 
 // simple command line UI, did not get around to using Qt or something more advanced 
 
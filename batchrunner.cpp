@@ -0,0 +1,508 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <chrono>
+#include <iomanip>
+#include "basicsimulator.cpp"
+#include "blocktranslator.cpp"
+#include "simpoint.cpp"
+#include "workloadgen.cpp"
+
+using namespace std;
+
+// headless front end for running many programs without the Qt window
+// build with: g++ batchrunner.cpp -std=c++11 -O2 -o batchrunner
+
+struct RunOptions {
+    bool pipeline = true;
+    bool cache = true;
+    bool verbose = false;
+    bool skip_stalls = true;
+    bool fetch_queue = false;
+    bool loop_buffer = false;
+    int dma_policy = DMA_POLICY_CPU_FIRST;
+    int victim_entries = 0;
+    int victim_latency = VICTIM_DELAY;
+    bool unit_stats = false; // set by --fu
+    FunctionalUnitConfig functional_units = FunctionalUnitConfig::singleCycle();
+    string breakpoints; // reported and then continued past, see BreakpointTable::parse
+    int max_cycles = 10000000;
+};
+
+static void printUsage() {
+    cout << "usage: batchrunner run [--no-pipeline] [--no-cache] [--verbose] [--no-skip] [--max-cycles N]\n"
+         << "                       [--fetch-queue] [--loop-buffer] [--dma-policy cpu|dma|rr] [--fu \"realistic, MUL=4/1, mul*2\"]\n"
+         << "                       [--victim N[:latency]]\n"
+         << "                       [--break \"12, 20 if R3 == 5, R4 >= 100, mem 64-79 rw\"] <program>...\n"
+         << "       batchrunner compare [--no-pipeline] [--no-cache] [--fetch-queue] [--loop-buffer] [--dma-policy P] [--fu SPEC]\n"
+         << "                           [--victim N[:latency]]\n"
+         << "                           [--max-cycles N] <program>...\n"
+         << "       batchrunner simpoint [--no-pipeline] [--no-cache] [--interval N] [--clusters K] [--warmup N] <program>...\n"
+         << "       batchrunner bench [--no-skip] [--repeat N] <program>...\n"
+         << "       batchrunner assemble <source> [output]\n"
+         << "       batchrunner assemble --bench <source> [count]\n"
+         << "       batchrunner gen [--working-set N] [--stride N] [--random] [--accesses N] [--loads F] [--chain N]\n"
+         << "                       [--branches F] [--unroll N] [--seed N] [--source FILE] [--sweep MAX] [output]\n";
+}
+
+static void printErrors(const string& filename, const vector<string>& errors) {
+    for (const string& error : errors)
+        cerr << filename << ": " << error << "\n";
+}
+
+// runs one program to completion, on whichever variant dispatchSimulator() picked for the options
+// returns 0 when it halted, 1 when it didn't (or failed to load), 2 for a bad breakpoint spec
+struct RunProgram {
+    const RunOptions& options;
+    const string& file;
+
+    template <class Sim>
+    int operator()(Sim& sim) {
+        sim.setFetchUnit(options.fetch_queue, options.loop_buffer);
+        sim.setDmaPolicy(options.dma_policy);
+        sim.setFunctionalUnits(options.functional_units);
+        sim.setVictimCache(options.victim_entries, options.victim_latency);
+        if (!sim.loadProgramFromFile(file)) {
+            printErrors(file, sim.getLoadErrors());
+            return 1;
+        }
+        string error;
+        if (!options.breakpoints.empty() && !sim.setBreakpoints(options.breakpoints, error)) {
+            cerr << error << "\n";
+            return 2;
+        }
+
+        // the simulator narrates every stall on cout, which is only useful when watching one program
+        if (!options.verbose) cout.setstate(ios::failbit);
+        auto start = chrono::steady_clock::now();
+        bool halted = false;
+        vector<string> breaks;
+        int break_count = 0;
+        if (options.skip_stalls) {
+            int flag;
+            while ((flag = sim.run(options.max_cycles - sim.getCycleCount())) == FLAG_BREAK) {
+                if (break_count++ < 10)
+                    breaks.push_back("  cycle " + to_string(sim.getCycleCount()) + ": " + sim.getBreakReason());
+            }
+            halted = flag == FLAG_HALT;
+        } else {
+            for (long long i = 0; i < options.max_cycles && !halted; i++)
+                halted = sim.step() == FLAG_HALT;
+        }
+        auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout.clear();
+
+        int hits = sim.getCacheHits();
+        int misses = sim.getCacheMisses();
+        cout << file << ": " << (halted ? "halted" : "cycle limit reached")
+             << "  cycles=" << sim.getCycleCount()
+             << "  instructions=" << sim.getInstructionCount()
+             << "  hits=" << hits << "  misses=" << misses
+             << "  stalls=" << sim.getStallCycles() << "  flushes=" << sim.getBranchFlushes()
+             << "  host_ms=" << elapsed * 1000.0 << "\n";
+        if (options.fetch_queue)
+            cout << "  fetch queue: occupancy=" << sim.getFetchQueueOccupancy() << " words  from_queue=" << sim.getQueueFetches()
+                 << "  line_reads=" << sim.getLineFetches() << "\n";
+        if (options.loop_buffer)
+            cout << "  loop buffer: hits=" << sim.getLoopBufferHits() << "  loops_captured=" << sim.getLoopsCaptured() << "\n";
+        if (sim.getVictimEntries() > 0)
+            cout << "  victim cache: entries=" << sim.getVictimEntries() << "  hits=" << sim.getVictimHits()
+                 << "  write_hits=" << sim.getVictimWriteHits() << "  writebacks=" << sim.getVictimWritebacks() << "\n";
+        if (options.unit_stats) {
+            const FunctionalUnitPool& units = sim.getFunctionalUnits();
+            for (int type = 0; type < NUM_FU_TYPES; type++) {
+                if (units.getIssues(type) == 0) continue;
+                cout << "  " << FunctionalUnitConfig::unitName(type) << " x" << units.getUnits(type)
+                     << ": issued=" << units.getIssues(type)
+                     << "  utilization=" << units.getUtilization(type, sim.getCycleCount())
+                     << "  structural_stalls=" << units.getStructuralStalls(type) << "\n";
+            }
+        }
+        if (sim.getDmaWords() > 0)
+            cout << "  dma: words=" << sim.getDmaWords() << "  port_cycles=" << sim.getDmaPortCycles()
+                 << "  pipeline_waits=" << sim.getDmaConflicts() << "\n";
+        for (const string& line : breaks) cout << line << "\n";
+        if (break_count > (int)breaks.size()) cout << "  ... " << break_count << " breaks in total\n";
+        return halted ? 0 : 1;
+    }
+};
+
+static int runPrograms(const RunOptions& options, const vector<string>& files) {
+    int failures = 0;
+    for (const string& file : files) {
+        RunProgram run = {options, file};
+        int status = dispatchSimulator(options.pipeline, options.cache, run);
+        if (status == 2) return 1;
+        if (status != 0) failures++;
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+// times repeated full runs of a program on one simulator type (a fresh simulator for each run)
+struct TimeProgram {
+    const vector<unsigned int>& words;
+    const RunOptions& options;
+    int repeat;
+    int cycles = 0;
+    int instructions = 0;
+    double seconds = 0;
+
+    TimeProgram(const vector<unsigned int>& program, const RunOptions& run_options, int runs)
+        : words(program), options(run_options), repeat(runs) {}
+
+    template <class Sim>
+    int operator()(Sim&) {
+        cout.setstate(ios::failbit);
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < repeat; i++) {
+            Sim sim(options.pipeline, options.cache);
+            sim.loadProgram(words);
+            if (options.skip_stalls) {
+                sim.run(options.max_cycles);
+            } else {
+                for (int c = 0; c < options.max_cycles && sim.step() != FLAG_HALT; c++) {}
+            }
+            cycles = sim.getCycleCount();
+            instructions = sim.getInstructionCount();
+        }
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout.clear();
+        return 0;
+    }
+};
+
+// host speed of the specialized variants against the runtime-flag Simulator, for every pipeline/cache mode
+static int benchVariants(const RunOptions& options, int repeat, const vector<string>& files) {
+    int failures = 0;
+    for (const string& file : files) {
+        AssemblyResult program = Assembler::loadProgramFile(file);
+        if (!program.ok()) {
+            printErrors(file, program.errors);
+            failures++;
+            continue;
+        }
+        cout << file << ":\n";
+        for (int mode = 3; mode >= 0; mode--) {
+            RunOptions variant = options;
+            variant.pipeline = mode & 2;
+            variant.cache = mode & 1;
+
+            TimeProgram runtime(program.words, variant, repeat);
+            Simulator unused;
+            runtime(unused);
+            TimeProgram fixed(program.words, variant, repeat);
+            dispatchSimulator(variant.pipeline, variant.cache, fixed);
+
+            bool same = runtime.cycles == fixed.cycles && runtime.instructions == fixed.instructions;
+            if (!same) failures++;
+            string mode_name = string(variant.pipeline ? "pipeline" : "no-pipeline") + (variant.cache ? ", cache" : ", no-cache");
+            cout << "  " << left << setw(22) << mode_name << right
+                 << "cycles=" << fixed.cycles << (same ? "" : " (MISMATCH)")
+                 << "  runtime_ms=" << runtime.seconds * 1000.0 / repeat << "  specialized_ms=" << fixed.seconds * 1000.0 / repeat
+                 << "  speedup=" << (fixed.seconds > 0 ? runtime.seconds / fixed.seconds : 0.0) << "x\n";
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+// runs each program on Simulator and on the block-translating FunctionalSimulator
+// and checks that registers and memory end up identical
+static int comparePrograms(const RunOptions& options, const vector<string>& files) {
+    int failures = 0;
+    for (const string& file : files) {
+        AssemblyResult program = Assembler::loadProgramFile(file);
+        if (!program.ok()) {
+            printErrors(file, program.errors);
+            failures++;
+            continue;
+        }
+
+        Simulator sim(options.pipeline, options.cache);
+        sim.setFetchUnit(options.fetch_queue, options.loop_buffer);
+        sim.setDmaPolicy(options.dma_policy);
+        sim.setFunctionalUnits(options.functional_units);
+        sim.setVictimCache(options.victim_entries, options.victim_latency);
+        sim.recordCounterReads(true);
+        sim.loadProgram(program.words);
+        cout.setstate(ios::failbit);
+        auto start = chrono::steady_clock::now();
+        bool halted = sim.run(options.max_cycles) == FLAG_HALT;
+        double detailed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout.clear();
+
+        FunctionalSimulator functional;
+        functional.loadProgram(program.words);
+        functional.replayCounterReads(&sim.getCounterReads()); // timings aren't modeled, only the instruction count
+        start = chrono::steady_clock::now();
+        functional.run(options.max_cycles);
+        double fast = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        int mismatches = 0;
+        for (int i = 0; i < NUM_REGISTERS; i++) {
+            if (sim.viewRegister(i) != functional.viewRegister(i)) {
+                if (mismatches++ < 10)
+                    cout << "  R" << i << ": simulator " << sim.viewRegister(i) << ", functional " << functional.viewRegister(i) << "\n";
+            }
+        }
+        for (int i = 0; i < NUM_VECTOR_REGISTERS * VECTOR_WIDTH; i++) {
+            if (sim.getVectorRegisters()[i] != functional.getVectorRegisters()[i]) {
+                if (mismatches++ < 10)
+                    cout << "  V" << i / VECTOR_WIDTH << "[" << i % VECTOR_WIDTH << "]: simulator " << sim.getVectorRegisters()[i]
+                         << ", functional " << functional.getVectorRegisters()[i] << "\n";
+            }
+        }
+        for (int addr = 0; addr < RAM_SIZE; addr++) {
+            if (sim.readMemory(addr) != functional.readMemory(addr)) {
+                if (mismatches++ < 10)
+                    cout << "  [" << addr << "]: simulator " << sim.readMemory(addr) << ", functional " << functional.readMemory(addr) << "\n";
+            }
+        }
+        if (!halted || !functional.isHalted()) mismatches++;
+
+        cout << file << ": " << (mismatches == 0 ? "match" : "MISMATCH")
+             << "  instructions=" << functional.getInstructionCount()
+             << "  blocks=" << functional.getBlocksTranslated()
+             << "  dispatches=" << functional.getBlockDispatches()
+             << "  chained=" << functional.getChainedDispatches()
+             << "  simulator_ms=" << detailed * 1000.0 << "  functional_ms=" << fast * 1000.0
+             << "  speedup=" << (fast > 0 ? detailed / fast : 0.0) << "x\n";
+        if (mismatches) failures++;
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+// sampled simulation, checked against a full detailed run of the same program
+static int simpointPrograms(const RunOptions& options, const SimPointConfig& config, const vector<string>& files) {
+    int failures = 0;
+    for (const string& file : files) {
+        AssemblyResult program = Assembler::loadProgramFile(file);
+        if (!program.ok()) {
+            printErrors(file, program.errors);
+            failures++;
+            continue;
+        }
+
+        cout.setstate(ios::failbit);
+        auto start = chrono::steady_clock::now();
+        SimPointResult sampled = SimPointSampler::sample(program.words, options.pipeline, options.cache, config);
+        double sampled_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        Simulator full(options.pipeline, options.cache);
+        full.loadProgram(program.words);
+        start = chrono::steady_clock::now();
+        bool halted = full.run(options.max_cycles) == FLAG_HALT;
+        double full_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout.clear();
+
+        if (!sampled.error.empty() || !halted) {
+            cerr << file << ": " << (sampled.error.empty() ? "full run did not halt" : sampled.error) << "\n";
+            failures++;
+            continue;
+        }
+
+        double full_cpi = full.getInstructionCount() ? (double)full.getCycleCount() / full.getInstructionCount() : 0;
+        int accesses = full.getCacheHits() + full.getCacheMisses();
+        double full_hit_rate = accesses ? (double)full.getCacheHits() / accesses : 0;
+
+        cout << file << ": " << sampled.intervals << " intervals of " << config.interval << " instructions, "
+             << sampled.samples.size() << " simulated in detail (" << sampled.detailed_instructions << " of "
+             << sampled.total_instructions << " instructions)\n";
+        for (const SimPointSample& sample : sampled.samples) {
+            cout << "  interval " << sample.interval << "  weight=" << sample.weight << " (" << sample.cluster_size << " intervals)"
+                 << "  cpi=" << (sample.instructions ? (double)sample.cycles / sample.instructions : 0.0)
+                 << "  hits=" << sample.hits << "  misses=" << sample.misses << "\n";
+        }
+        cout << "  sampled: cpi=" << sampled.cpi << "  hit_rate=" << sampled.hit_rate * 100 << "%  host_ms=" << sampled_time * 1000 << "\n"
+             << "  full:    cpi=" << full_cpi << "  hit_rate=" << full_hit_rate * 100 << "%  host_ms=" << full_time * 1000 << "\n"
+             << "  error:   cpi " << (full_cpi ? 100.0 * (sampled.cpi - full_cpi) / full_cpi : 0.0) << "%  hit_rate "
+             << (sampled.hit_rate - full_hit_rate) * 100 << " points\n";
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+static int assembleProgram(const string& source, const string& output) {
+    AssemblyResult program = Assembler::loadProgramFile(source);
+    if (!program.ok()) {
+        printErrors(source, program.errors);
+        return 1;
+    }
+    ofstream out(output);
+    if (!out) {
+        cerr << "cannot write " << output << "\n";
+        return 1;
+    }
+    Assembler::writeImage(out, program.words);
+    return 0;
+}
+
+// assembles the same source repeatedly to measure throughput for generated-kernel sweeps
+static int benchAssembler(const string& source, int count) {
+    ifstream infile(source);
+    if (!infile) {
+        cerr << "cannot open " << source << "\n";
+        return 1;
+    }
+    stringstream buffer;
+    buffer << infile.rdbuf();
+    string text = buffer.str();
+
+    auto start = chrono::steady_clock::now();
+    size_t words = 0;
+    for (int i = 0; i < count; i++) {
+        AssemblyResult program = Assembler::assemble(text);
+        if (!program.ok()) {
+            printErrors(source, program.errors);
+            return 1;
+        }
+        words += program.words.size();
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << count << " assemblies (" << words << " words) in " << elapsed * 1000.0 << " ms, "
+         << count / elapsed << " programs/s\n";
+    return 0;
+}
+
+// writes one generated image, or with sweep > 0 runs the workload at doubling working sets up to sweep
+// and prints the miss rate of each, which should step up once the working set outgrows the cache
+static int generateWorkload(const WorkloadParams& params, const string& output, const string& source, int sweep) {
+    if (sweep > 0) {
+        WorkloadParams point = params;
+        for (point.working_set = 1; point.working_set <= sweep; point.working_set *= 2) {
+            GeneratedWorkload workload = WorkloadGenerator::generate(point);
+            if (!workload.error.empty()) {
+                cerr << "working set " << point.working_set << ": " << workload.error << "\n";
+                return 1;
+            }
+            Simulator sim(true, true);
+            sim.loadProgram(workload.image);
+            cout.setstate(ios::failbit);
+            bool halted = sim.run(100000000) == FLAG_HALT;
+            cout.clear();
+            int accesses = sim.getCacheHits() + sim.getCacheMisses();
+            cout << "working_set=" << point.working_set << (halted ? "" : " (cycle limit reached)")
+                 << "  cycles=" << sim.getCycleCount() << "  instructions=" << sim.getInstructionCount()
+                 << "  cpi=" << (sim.getInstructionCount() ? (double)sim.getCycleCount() / sim.getInstructionCount() : 0.0)
+                 << "  miss_rate=" << (accesses ? 100.0 * sim.getCacheMisses() / accesses : 0.0) << "%\n";
+        }
+        return 0;
+    }
+
+    GeneratedWorkload workload = WorkloadGenerator::generate(params);
+    if (!workload.error.empty()) {
+        cerr << workload.error << "\n";
+        return 1;
+    }
+    ofstream out(output);
+    if (!out) {
+        cerr << "cannot write " << output << "\n";
+        return 1;
+    }
+    Assembler::writeImage(out, workload.image);
+    if (!source.empty()) {
+        ofstream listing(source);
+        if (!listing) {
+            cerr << "cannot write " << source << "\n";
+            return 1;
+        }
+        listing << workload.source;
+    }
+    cout << output << ": " << workload.image.size() << " words, data at " << workload.data_base << "\n";
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+    string command = argv[1];
+
+    if (command == "run" || command == "compare" || command == "simpoint" || command == "bench") {
+        RunOptions options;
+        SimPointConfig simpoint;
+        int repeat = 20;
+        vector<string> files;
+        for (int i = 2; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--no-pipeline") options.pipeline = false;
+            else if (arg == "--no-cache") options.cache = false;
+            else if (arg == "--verbose") options.verbose = true;
+            else if (arg == "--max-cycles" && i + 1 < argc) options.max_cycles = atoi(argv[++i]);
+            else if (arg == "--no-skip") options.skip_stalls = false;
+            else if (arg == "--fetch-queue") options.fetch_queue = true;
+            else if (arg == "--loop-buffer") options.loop_buffer = true;
+            else if (arg == "--fu" && i + 1 < argc) {
+                string error;
+                if (!options.functional_units.parse(argv[++i], error)) {
+                    cerr << error << "\n";
+                    return 1;
+                }
+                options.unit_stats = true;
+            }
+            else if (arg == "--victim" && i + 1 < argc) {
+                string spec = argv[++i];
+                size_t colon = spec.find(':');
+                options.victim_entries = max(0, atoi(spec.substr(0, colon).c_str()));
+                if (colon != string::npos) options.victim_latency = max(1, atoi(spec.substr(colon + 1).c_str()));
+            }
+            else if (arg == "--dma-policy" && i + 1 < argc) {
+                string policy = argv[++i];
+                if (policy == "cpu") options.dma_policy = DMA_POLICY_CPU_FIRST;
+                else if (policy == "dma") options.dma_policy = DMA_POLICY_DMA_FIRST;
+                else if (policy == "rr") options.dma_policy = DMA_POLICY_ROUND_ROBIN;
+                else {
+                    cerr << "unknown DMA policy '" << policy << "', expected cpu, dma or rr\n";
+                    return 1;
+                }
+            }
+            else if (arg == "--break" && i + 1 < argc) options.breakpoints = argv[++i];
+            else if (arg == "--interval" && i + 1 < argc) simpoint.interval = max(1, atoi(argv[++i]));
+            else if (arg == "--clusters" && i + 1 < argc) simpoint.max_clusters = max(1, atoi(argv[++i]));
+            else if (arg == "--warmup" && i + 1 < argc) simpoint.warmup = max(0, atoi(argv[++i]));
+            else if (arg == "--repeat" && i + 1 < argc) repeat = max(1, atoi(argv[++i]));
+            else files.push_back(arg);
+        }
+        if (files.empty()) {
+            printUsage();
+            return 1;
+        }
+        if (command == "simpoint") return simpointPrograms(options, simpoint, files);
+        if (command == "bench") return benchVariants(options, repeat, files);
+        return command == "run" ? runPrograms(options, files) : comparePrograms(options, files);
+    }
+
+    if (command == "assemble") {
+        if (argc >= 4 && string(argv[2]) == "--bench")
+            return benchAssembler(argv[3], argc >= 5 ? atoi(argv[4]) : 1000);
+        if (argc == 3 || argc == 4)
+            return assembleProgram(argv[2], argc == 4 ? argv[3] : "output.txt");
+    }
+
+    if (command == "gen") {
+        WorkloadParams params;
+        string output = "workload.txt", source;
+        int sweep = 0;
+        for (int i = 2; i < argc; i++) {
+            string arg = argv[i];
+            bool value = i + 1 < argc;
+            if (arg == "--working-set" && value) params.working_set = atoi(argv[++i]);
+            else if (arg == "--stride" && value) params.stride = atoi(argv[++i]);
+            else if (arg == "--random") params.random = true;
+            else if (arg == "--accesses" && value) params.accesses = atoi(argv[++i]);
+            else if (arg == "--loads" && value) params.load_fraction = atof(argv[++i]);
+            else if (arg == "--chain" && value) params.chain_length = atoi(argv[++i]);
+            else if (arg == "--branches" && value) params.branch_density = atof(argv[++i]);
+            else if (arg == "--unroll" && value) params.unroll = atoi(argv[++i]);
+            else if (arg == "--seed" && value) params.seed = (unsigned int)strtoul(argv[++i], nullptr, 10);
+            else if (arg == "--source" && value) source = argv[++i];
+            else if (arg == "--sweep" && value) sweep = atoi(argv[++i]);
+            else output = arg;
+        }
+        return generateWorkload(params, output, source, sweep);
+    }
+
+    printUsage();
+    return 1;
+}
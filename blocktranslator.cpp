@@ -0,0 +1,515 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <string>
+#include "basicsimulator.cpp"
+
+using namespace std;
+
+// functional (untimed) simulator that translates each basic block once into a list of
+// pre-decoded host operations instead of re-running decode/execute for every instruction
+// register and memory results match Simulator, including its quirks (unimplemented ALU ops write 0)
+
+constexpr int MAX_BLOCK_LENGTH = 64;
+
+struct MemoryAccess {
+    int address;
+    bool write;
+};
+
+class FunctionalSimulator;
+
+struct HostOp;
+typedef bool (*OpHandler)(FunctionalSimulator&, const HostOp&); // returns false to leave the block early
+
+struct HostOp {
+    OpHandler handler;
+    int rd = 0, rs1 = 0, rs2 = 0;
+    int imm = 0;
+    int cond = 0;
+    int br1 = 0, br2 = 0; // branch operands for a fused ADD + BRN
+    int addr = 0;         // address of the (first) instruction this op came from
+    int width = 1;        // number of guest instructions covered
+};
+
+struct TranslatedBlock {
+    int start = 0;
+    int end = 0;                 // one past the last instruction
+    vector<HostOp> ops;          // fused sequence, used when the whole block runs
+    vector<HostOp> steps;        // one op per instruction, used when a run budget ends mid-block
+    TranslatedBlock* taken = nullptr;       // chained successor when the block's branch is taken
+    TranslatedBlock* fallthrough = nullptr; // chained successor otherwise
+    bool dead = false;
+};
+
+class FunctionalSimulator {
+private:
+    vector<int> registers;
+    vector<int> vector_registers;
+    vector<int> ram;
+    int program_counter = 0;
+    bool halted = false;
+    bool faulted = false;
+    long long instruction_count = 0;
+
+    // performance counters: retired instructions are counted exactly, the others have no timing model here and
+    // read as 0 unless replayCounterReads() supplies the values a Simulator run of the same program read
+    long long counter_base = 0;                 // instructions retired before the RSTCTR that last cleared the count
+    const vector<int>* counter_replay = nullptr;
+    size_t counter_reads = 0;                   // RDCTRs run so far, the position in counter_replay
+
+    vector<unique_ptr<TranslatedBlock>> blocks;
+    vector<TranslatedBlock*> block_at; // block starting at each address, if translated
+    vector<int> code_refs;             // number of live blocks covering each address
+
+    // set by the ops while a block runs
+    int block_start = 0; // where the running block started, so op.addr - block_start instructions of it have retired
+    int next_pc = 0;
+    bool branch_taken = false;
+    bool code_written = false;
+
+    long long blocks_translated = 0;
+    long long block_dispatches = 0;
+    long long chained_dispatches = 0;
+    long long invalidations = 0;
+
+    // profiling for sampled simulation (simpoint.cpp), both off unless requested
+    vector<long long> block_profile;          // instructions run per block start address
+    vector<int> profiled_blocks;              // start addresses with a non-zero count
+    vector<MemoryAccess>* access_trace = nullptr; // every fetch and data access, in order
+
+    // ---- host operations, one per opcode with operands baked in ----
+
+    static bool opLoad(FunctionalSimulator& s, const HostOp& op) {
+        int address = s.registers[op.rs1] + s.registers[op.rs2] + op.imm;
+        if (address < 0 || address >= RAM_SIZE) return s.fault(op);
+        if (s.access_trace) s.access_trace->push_back({address, false});
+        s.registers[op.rd] = s.ram[address];
+        return true;
+    }
+
+    static bool opStore(FunctionalSimulator& s, const HostOp& op) {
+        int address = s.registers[op.rs1] + s.registers[op.rs2] + op.imm;
+        if (address < 0 || address >= RAM_SIZE) return s.fault(op);
+        if (s.access_trace) s.access_trace->push_back({address, true});
+        s.ram[address] = s.registers[op.rd];
+        if (address == DMA_CONTROL) return s.runDma(op);
+        if (s.code_refs[address] == 0) return true;
+        // overwrote translated code, drop the stale blocks and resume after this store
+        s.invalidate(address);
+        s.next_pc = op.addr + 1;
+        s.branch_taken = false;
+        return false;
+    }
+
+    // vector addresses are aligned down to a whole vector, like Simulator::execute does
+    static int vectorAddress(FunctionalSimulator& s, const HostOp& op) {
+        int address = s.registers[op.rs1] + s.registers[op.rs2] + op.imm;
+        return address - address % VECTOR_WIDTH;
+    }
+
+    static bool opVLoad(FunctionalSimulator& s, const HostOp& op) {
+        int address = vectorAddress(s, op);
+        if (address < 0 || address + VECTOR_WIDTH > RAM_SIZE) return s.fault(op);
+        if (s.access_trace) s.access_trace->push_back({address, false});
+        for (int i = 0; i < VECTOR_WIDTH; i++) s.vector_registers[op.rd * VECTOR_WIDTH + i] = s.ram[address + i];
+        return true;
+    }
+
+    static bool opVStore(FunctionalSimulator& s, const HostOp& op) {
+        int address = vectorAddress(s, op);
+        if (address < 0 || address + VECTOR_WIDTH > RAM_SIZE) return s.fault(op);
+        if (s.access_trace) s.access_trace->push_back({address, true});
+        bool hit_code = false;
+        for (int i = 0; i < VECTOR_WIDTH; i++) {
+            s.ram[address + i] = s.vector_registers[op.rd * VECTOR_WIDTH + i];
+            if (s.code_refs[address + i] == 0) continue;
+            s.invalidate(address + i);
+            hit_code = true;
+        }
+        if (address <= DMA_CONTROL && address + VECTOR_WIDTH > DMA_CONTROL && !s.runDma(op)) return false;
+        if (!hit_code) return true;
+        s.next_pc = op.addr + 1;
+        s.branch_taken = false;
+        return false;
+    }
+
+    static bool opVAdd(FunctionalSimulator& s, const HostOp& op) {
+        for (int i = 0; i < VECTOR_WIDTH; i++)
+            s.vector_registers[op.rd * VECTOR_WIDTH + i] = (int)((unsigned int)s.vector_registers[op.rs1 * VECTOR_WIDTH + i] +
+                                                                 (unsigned int)s.vector_registers[op.rs2 * VECTOR_WIDTH + i]);
+        return true;
+    }
+
+    static bool opVMul(FunctionalSimulator& s, const HostOp& op) {
+        for (int i = 0; i < VECTOR_WIDTH; i++)
+            s.vector_registers[op.rd * VECTOR_WIDTH + i] = (int)((unsigned int)s.vector_registers[op.rs1 * VECTOR_WIDTH + i] *
+                                                                 (unsigned int)s.vector_registers[op.rs2 * VECTOR_WIDTH + i]);
+        return true;
+    }
+
+    static bool opVRed(FunctionalSimulator& s, const HostOp& op) {
+        unsigned int sum = 0;
+        for (int i = 0; i < VECTOR_WIDTH; i++) sum += (unsigned int)s.vector_registers[op.rs1 * VECTOR_WIDTH + i];
+        s.registers[op.rd] = (int)sum;
+        return true;
+    }
+
+    static bool opLoadImm(FunctionalSimulator& s, const HostOp& op) {
+        s.registers[op.rd] = op.imm;
+        return true;
+    }
+
+    static bool opAdd(FunctionalSimulator& s, const HostOp& op) {
+        s.registers[op.rd] = (int)((unsigned int)s.registers[op.rs1] + (unsigned int)s.registers[op.rs2]);
+        return true;
+    }
+
+    static bool opSub(FunctionalSimulator& s, const HostOp& op) {
+        s.registers[op.rd] = (int)((unsigned int)s.registers[op.rs1] - (unsigned int)s.registers[op.rs2]);
+        return true;
+    }
+
+    static bool opMul(FunctionalSimulator& s, const HostOp& op) {
+        s.registers[op.rd] = (int)((unsigned int)s.registers[op.rs1] * (unsigned int)s.registers[op.rs2]);
+        return true;
+    }
+
+    // instructions retired before op, the count Simulator's RDCTR sees without the pipeline
+    long long retiredBefore(const HostOp& op) const { return instruction_count + (op.addr - block_start); }
+
+    static bool opReadCounter(FunctionalSimulator& s, const HostOp& op) {
+        int value = 0;
+        if (s.counter_replay && s.counter_reads < s.counter_replay->size()) value = (*s.counter_replay)[s.counter_reads];
+        if (op.imm == CTR_INSTRUCTIONS) value = (int)(s.retiredBefore(op) - s.counter_base);
+        s.counter_reads++;
+        s.registers[op.rd] = value;
+        return true;
+    }
+
+    static bool opResetCounter(FunctionalSimulator& s, const HostOp& op) {
+        if (op.imm == CTR_INSTRUCTIONS || op.imm == CTR_ALL) s.counter_base = s.retiredBefore(op);
+        return true;
+    }
+
+    // ALU opcodes that decode with a writeback but have no case in Simulator::execute
+    static bool opZero(FunctionalSimulator& s, const HostOp& op) {
+        s.registers[op.rd] = 0;
+        return true;
+    }
+
+    static bool opNop(FunctionalSimulator&, const HostOp&) { return true; }
+
+    static bool evaluateCond(int cond, int op1, int op2) {
+        switch (cond) {
+            case 0: return op1 == op2;
+            case 1: return op1 < op2;
+            case 2: return op1 >= op2;
+            case 3: return op1 != op2;
+            default: return false;
+        }
+    }
+
+    static bool opBranch(FunctionalSimulator& s, const HostOp& op) {
+        s.branch_taken = evaluateCond(op.cond, s.registers[op.br1], s.registers[op.br2]);
+        s.next_pc = s.branch_taken ? op.imm : op.addr + 1;
+        return true;
+    }
+
+    // ADD Rd Rs1 Rs2 followed by BRN, the usual loop-counter idiom
+    static bool opAddBranch(FunctionalSimulator& s, const HostOp& op) {
+        s.registers[op.rd] = (int)((unsigned int)s.registers[op.rs1] + (unsigned int)s.registers[op.rs2]);
+        s.branch_taken = evaluateCond(op.cond, s.registers[op.br1], s.registers[op.br2]);
+        s.next_pc = s.branch_taken ? op.imm : op.addr + 2;
+        return true;
+    }
+
+    static bool opJump(FunctionalSimulator& s, const HostOp& op) {
+        s.next_pc = s.registers[op.br1];
+        s.branch_taken = true;
+        return true;
+    }
+
+    static bool opHalt(FunctionalSimulator& s, const HostOp& op) {
+        s.halted = true;
+        s.next_pc = op.addr;
+        return false;
+    }
+
+    // a store to DMA_CONTROL runs the whole transfer at once, same result as the timed DMA engine once its
+    // status reads idle again; returns false (leave the block after the store) if it wrote over translated code
+    bool runDma(const HostOp& op) {
+        int command = ram[DMA_CONTROL], src = ram[DMA_SRC], dst = ram[DMA_DST], count = ram[DMA_COUNT];
+        int status = dmaCommandStatus(command, src, dst, count);
+        ram[DMA_STATUS] = status == DMA_ERROR ? DMA_ERROR : DMA_IDLE;
+        if (status != DMA_BUSY) return true;
+        bool hit_code = false;
+        for (int i = 0; i < count; i++) {
+            ram[dst + i] = command == DMA_CMD_COPY ? ram[src + i] : ram[DMA_FILL];
+            if (code_refs[dst + i] == 0) continue;
+            invalidate(dst + i);
+            hit_code = true;
+        }
+        if (!hit_code) return true;
+        next_pc = op.addr + 1;
+        branch_taken = false;
+        return false;
+    }
+
+    bool fault(const HostOp& op) {
+        halted = true;
+        faulted = true;
+        next_pc = op.addr;
+        return false;
+    }
+
+    // ---- translation ----
+
+    // decodes one word the same way Simulator::decode does; returns true if it ends the block
+    static bool translateWord(unsigned int word, int addr, HostOp& op) {
+        op.addr = addr;
+        if (word == 0xFFFFFFFF) {
+            op.handler = opHalt;
+            return true;
+        }
+        int opcode = (word & 0xF8000000) >> 27;
+        int r0 = (word & 0x07800000) >> 23;
+        int r1 = (word & 0x00780000) >> 19;
+        int r2 = (word & 0x00078000) >> 15;
+        op.rd = r0;
+        op.rs1 = r1;
+        op.rs2 = r2;
+        if (!vectorRegistersValid(word)) {
+            op.handler = opNop; // names a vector register past V7, same as Simulator::decode
+            return false;
+        }
+        switch (opcode) {
+            case 0: op.handler = opLoad; op.imm = word & 0x00007FFF; break;
+            case 1: op.handler = opStore; op.imm = word & 0x00007FFF; break;
+            case 3: op.handler = opLoadImm; op.imm = word & 0x007FFFFF; break;
+            case 5: op.handler = opAdd; break;
+            case 7: op.handler = opSub; break;
+            case 9: op.handler = opMul; break;
+            case 2: case 11: case 13: case 16: case 17: case 18: case 19: // type A
+            case 6: case 8: case 10: case 12: case 14:                   // type B
+            case 15:                                                     // SHF
+                op.handler = opZero;
+                break;
+            case OPCODE_RDCTR: op.handler = opReadCounter; op.imm = word & 0x007FFFFF; break;
+            case OPCODE_RSTCTR: op.handler = opResetCounter; op.imm = word & 0x007FFFFF; break;
+            case OPCODE_VLOAD: op.handler = opVLoad; op.imm = word & 0x00007FFF; break;
+            case OPCODE_VSTR: op.handler = opVStore; op.imm = word & 0x00007FFF; break;
+            case OPCODE_VADD: op.handler = opVAdd; break;
+            case OPCODE_VMUL: op.handler = opVMul; break;
+            case OPCODE_VRED: op.handler = opVRed; break;
+            case 20:
+                op.handler = opBranch;
+                op.br1 = r0;
+                op.br2 = r1;
+                op.cond = (word & 0x00060000) >> 17;
+                op.imm = word & 0x0001FFFF;
+                return true;
+            case 21:
+                op.handler = opJump;
+                op.br1 = r0;
+                return true;
+            default: op.handler = opNop; break; // LOADIZ, SUBJ and unknown opcodes do nothing
+        }
+        return false;
+    }
+
+    TranslatedBlock* translate(int start) {
+        unique_ptr<TranslatedBlock> block(new TranslatedBlock());
+        block->start = start;
+        int addr = start;
+        while (addr < RAM_SIZE && addr - start < MAX_BLOCK_LENGTH) {
+            HostOp op;
+            bool ends_block = translateWord((unsigned int)ram[addr], addr, op);
+            block->steps.push_back(op);
+            addr++;
+            if (ends_block) break;
+        }
+        block->end = addr;
+
+        // fuse ADD into a following BRN when the add feeds nothing else in between
+        for (size_t i = 0; i < block->steps.size(); i++) {
+            const HostOp& op = block->steps[i];
+            if (op.handler == opAdd && i + 1 < block->steps.size() && block->steps[i + 1].handler == opBranch) {
+                HostOp fused = block->steps[i + 1];
+                fused.handler = opAddBranch;
+                fused.rd = op.rd;
+                fused.rs1 = op.rs1;
+                fused.rs2 = op.rs2;
+                fused.addr = op.addr;
+                fused.width = 2;
+                block->ops.push_back(fused);
+                i++;
+            } else {
+                block->ops.push_back(op);
+            }
+        }
+
+        for (int i = block->start; i < block->end; i++) code_refs[i]++;
+        TranslatedBlock* result = block.get();
+        block_at[start] = result;
+        blocks.push_back(move(block));
+        blocks_translated++;
+        return result;
+    }
+
+    void invalidate(int address) {
+        invalidations++;
+        for (auto& block : blocks) {
+            if (block->dead || address < block->start || address >= block->end) continue;
+            block->dead = true;
+            if (block_at[block->start] == block.get()) block_at[block->start] = nullptr;
+            for (int i = block->start; i < block->end; i++) code_refs[i]--;
+        }
+        for (auto& block : blocks) {
+            if (block->taken && block->taken->dead) block->taken = nullptr;
+            if (block->fallthrough && block->fallthrough->dead) block->fallthrough = nullptr;
+        }
+        code_written = true;
+    }
+
+    // dead blocks are only freed between blocks, never while one of them is running
+    void collectDeadBlocks() {
+        size_t kept = 0;
+        for (size_t i = 0; i < blocks.size(); i++)
+            if (!blocks[i]->dead) blocks[kept++] = move(blocks[i]);
+        blocks.resize(kept);
+        code_written = false;
+    }
+
+    TranslatedBlock* lookup(int pc) {
+        TranslatedBlock* block = block_at[pc];
+        return block ? block : translate(pc);
+    }
+
+public:
+    FunctionalSimulator()
+        : registers(NUM_REGISTERS, 0), vector_registers(NUM_VECTOR_REGISTERS * VECTOR_WIDTH, 0), ram(RAM_SIZE, 0),
+          block_at(RAM_SIZE, nullptr), code_refs(RAM_SIZE, 0) {}
+
+    void loadProgram(const vector<unsigned int>& words) {
+        for (int addr = 0; addr < (int)words.size() && addr < RAM_SIZE; addr++)
+            ram[addr] = words[addr];
+        blocks.clear();
+        fill(block_at.begin(), block_at.end(), nullptr);
+        fill(code_refs.begin(), code_refs.end(), 0);
+        program_counter = 0;
+        halted = false;
+        faulted = false;
+        instruction_count = 0;
+        counter_base = 0;
+        counter_reads = 0;
+    }
+
+    // runs until HALT or until max_instructions more instructions have retired
+    // returns the number of instructions retired by this call
+    long long run(long long max_instructions) {
+        long long retired = 0;
+        TranslatedBlock* block = nullptr;
+        while (!halted && retired < max_instructions) {
+            if (program_counter < 0 || program_counter >= RAM_SIZE) {
+                halted = true; // same as Simulator::fetch running off the end of memory
+                break;
+            }
+            if (!block) block = lookup(program_counter);
+            block_dispatches++;
+
+            long long budget = max_instructions - retired;
+            bool whole_block = budget >= block->end - block->start;
+            // tracing needs each fetch in order, so it runs the unfused steps
+            const vector<HostOp>& ops = whole_block && !access_trace ? block->ops : block->steps;
+            block_start = block->start;
+            next_pc = block->end;
+            branch_taken = false;
+
+            size_t i = 0;
+            long long done = 0;
+            for (; i < ops.size() && done < budget; i++) {
+                const HostOp& op = ops[i];
+                if (access_trace) access_trace->push_back({op.addr, false});
+                bool keep_going = op.handler(*this, op);
+                if (op.handler != opHalt && !faulted) done += op.width;
+                if (!keep_going) break;
+            }
+            if (!whole_block && i < ops.size() && done == budget && !halted && !code_written)
+                next_pc = ops[i].addr; // stopped partway through the block
+            retired += done;
+            instruction_count += done;
+            program_counter = next_pc;
+            if (!block_profile.empty() && done > 0) {
+                if (block_profile[block_start] == 0) profiled_blocks.push_back(block_start);
+                block_profile[block_start] += done;
+            }
+
+            TranslatedBlock* next = nullptr;
+            if (code_written) {
+                collectDeadBlocks();
+            } else if (whole_block && !halted) {
+                // follow or create the chain link for direct branches; JUMP targets can change so always look them up
+                const HostOp& last = ops.back();
+                if (last.handler == opJump || program_counter < 0 || program_counter >= RAM_SIZE) {
+                    next = nullptr;
+                } else if (branch_taken) {
+                    if (!block->taken) block->taken = lookup(program_counter);
+                    next = block->taken;
+                    chained_dispatches++;
+                } else {
+                    if (!block->fallthrough) block->fallthrough = lookup(program_counter);
+                    next = block->fallthrough;
+                    chained_dispatches++;
+                }
+            }
+            block = next;
+        }
+        return retired;
+    }
+
+    long long runToCompletion() {
+        long long total = 0;
+        while (!halted) total += run(1LL << 40);
+        return total;
+    }
+
+    // counts instructions per basic block from now on, see takeBlockProfile()
+    void enableBlockProfile() {
+        if (block_profile.empty()) block_profile.assign(RAM_SIZE, 0);
+    }
+
+    // the basic-block vector since the last call, as (block start address, instructions) pairs
+    vector<pair<int, long long>> takeBlockProfile() {
+        vector<pair<int, long long>> profile;
+        for (int start : profiled_blocks) {
+            profile.push_back(make_pair(start, block_profile[start]));
+            block_profile[start] = 0;
+        }
+        profiled_blocks.clear();
+        return profile;
+    }
+
+    // RDCTRs of counters other than retired instructions return values[0], values[1], ... in order (see
+    // Simulator::recordCounterReads), so a program that computes with its timings still ends up the same
+    void replayCounterReads(const vector<int>* values) { counter_replay = values; }
+
+    // records every fetch and data access into trace until called again with nullptr
+    void setAccessTrace(vector<MemoryAccess>* trace) { access_trace = trace; }
+
+    const vector<int>& getRegisters() const { return registers; }
+    const vector<int>& getVectorRegisters() const { return vector_registers; }
+    const vector<int>& getMemory() const { return ram; }
+
+    bool isHalted() const { return halted; }
+    bool isFaulted() const { return faulted; }
+    int getProgramCounter() const { return program_counter; }
+    long long getInstructionCount() const { return instruction_count; }
+    int viewRegister(int reg) const { return registers[reg]; }
+    int readMemory(int address) const { return ram[address]; }
+
+    long long getBlocksTranslated() const { return blocks_translated; }
+    long long getBlockDispatches() const { return block_dispatches; }
+    long long getChainedDispatches() const { return chained_dispatches; }
+    long long getInvalidations() const { return invalidations; }
+};
@@ -0,0 +1,216 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <sstream>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+#include "memoryUI.cpp"
+
+using namespace std;
+
+// breakpoint/watchpoint tables for Simulator
+// everything is precompiled into lookup tables so the hot loop only does an array index:
+// a bitmap over instruction addresses for PC breakpoints, a bitmask of watched registers,
+// and (in MemorySystem) a bitmap over RAM for memory watchpoints
+
+constexpr int COND_EQ = 0;
+constexpr int COND_LT = 1;
+constexpr int COND_GE = 2;
+constexpr int COND_NE = 3;
+constexpr int COND_GT = 4;
+constexpr int COND_LE = 5;
+
+constexpr unsigned char PC_BREAK = 1;
+constexpr unsigned char PC_BREAK_IF = 2;
+
+struct RegisterCondition {
+    int reg = -1;
+    int cond = COND_EQ;
+    int value = 0;
+
+    bool holds(int reg_value) const {
+        switch (cond) {
+            case COND_EQ: return reg_value == value;
+            case COND_LT: return reg_value < value;
+            case COND_GE: return reg_value >= value;
+            case COND_NE: return reg_value != value;
+            case COND_GT: return reg_value > value;
+            case COND_LE: return reg_value <= value;
+            default: return false;
+        }
+    }
+
+    string describe() const {
+        static const char* names[] = {"==", "<", ">=", "!=", ">", "<="};
+        return "R" + to_string(reg) + " " + names[cond] + " " + to_string(value);
+    }
+};
+
+struct MemoryWatch {
+    int low = 0;
+    int high = 0; // inclusive
+    int kinds = 0; // WATCH_READ and/or WATCH_WRITE
+};
+
+class BreakpointTable {
+private:
+    int num_registers;
+    vector<unsigned char> pc_map = vector<unsigned char>(RAM_SIZE, 0); // PC_BREAK, PC_BREAK_IF or 0
+    // only consulted once pc_map says there is a conditional breakpoint
+    unordered_map<int, vector<RegisterCondition>> pc_conditions;
+    vector<vector<RegisterCondition>> register_watches;
+    unsigned int register_mask = 0;
+    bool active = false;
+
+    static bool parseNumber(const string& token, int& value) {
+        if (token.empty()) return false;
+        char* end;
+        bool hex = token.size() > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X');
+        value = (int)strtol(token.c_str(), &end, hex ? 16 : 10);
+        return *end == '\0';
+    }
+
+    bool parseRegister(const string& token, int& reg) const {
+        if (token.size() < 2 || (token[0] != 'R' && token[0] != 'r')) return false;
+        return parseNumber(token.substr(1), reg) && reg >= 0 && reg < num_registers;
+    }
+
+    static bool parseCond(const string& token, int& cond) {
+        static const unordered_map<string, int> ops = {
+            {"==", COND_EQ}, {"=", COND_EQ}, {"<", COND_LT}, {">=", COND_GE},
+            {"!=", COND_NE}, {">", COND_GT}, {"<=", COND_LE},
+        };
+        auto found = ops.find(token);
+        if (found == ops.end()) return false;
+        cond = found->second;
+        return true;
+    }
+
+    // splits "R3>=5" the same as "R3 >= 5"
+    static vector<string> tokenize(const string& entry) {
+        vector<string> tokens;
+        size_t i = 0;
+        while (i < entry.size()) {
+            if (isspace((unsigned char)entry[i])) { i++; continue; }
+            size_t start = i;
+            bool op = strchr("=<>!", entry[i]) != nullptr;
+            while (i < entry.size() && !isspace((unsigned char)entry[i]) && (strchr("=<>!", entry[i]) != nullptr) == op) i++;
+            tokens.push_back(entry.substr(start, i - start));
+        }
+        return tokens;
+    }
+
+    bool parseCondition(const vector<string>& tokens, size_t first, RegisterCondition& condition) const {
+        return tokens.size() == first + 3 && parseRegister(tokens[first], condition.reg) &&
+               parseCond(tokens[first + 1], condition.cond) && parseNumber(tokens[first + 2], condition.value);
+    }
+
+public:
+    BreakpointTable(int registers) : num_registers(registers), register_watches(registers) {}
+
+    void clear() {
+        fill(pc_map.begin(), pc_map.end(), 0);
+        pc_conditions.clear();
+        for (auto& watches : register_watches) watches.clear();
+        register_mask = 0;
+        active = false;
+    }
+
+    void addBreakpoint(int pc) {
+        pc_map[pc] = PC_BREAK;
+        pc_conditions.erase(pc); // an unconditional breakpoint wins over conditional ones at the same PC
+        active = true;
+    }
+
+    void addBreakpoint(int pc, const RegisterCondition& condition) {
+        if (pc_map[pc] == PC_BREAK) return; // already unconditional
+        pc_map[pc] = PC_BREAK_IF;
+        pc_conditions[pc].push_back(condition);
+        active = true;
+    }
+
+    void addRegisterWatch(const RegisterCondition& condition) {
+        register_watches[condition.reg].push_back(condition);
+        register_mask |= 1u << condition.reg;
+        active = true;
+    }
+
+    bool isActive() const { return active; }
+    // unconditional, checked whenever the PC changes
+    bool hasBreakpoint(int pc) const { return pc >= 0 && pc < RAM_SIZE && pc_map[pc] == PC_BREAK; }
+    // conditional, checked when the instruction at pc retires
+    bool hasConditionalBreakpoint(int pc) const { return pc >= 0 && pc < RAM_SIZE && pc_map[pc] == PC_BREAK_IF; }
+    bool watchesRegister(int reg) const { return (register_mask >> reg) & 1; }
+
+    // only call when hasConditionalBreakpoint(pc); registers has to be the register file before the instruction
+    // at pc writes back, which holds the results of every older instruction whether or not the pipeline is on
+    bool breakpointFires(int pc, const vector<int>& registers, string& reason) const {
+        for (const RegisterCondition& condition : pc_conditions.find(pc)->second) {
+            if (condition.holds(registers[condition.reg])) {
+                reason = "breakpoint at PC " + to_string(pc) + " (" + condition.describe() + ")";
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool registerWatchFires(int reg, int value, string& reason) const {
+        for (const RegisterCondition& condition : register_watches[reg]) {
+            if (condition.holds(value)) {
+                reason = "R" + to_string(reg) + " written with " + to_string(value) + " (" + condition.describe() + ")";
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // parses a comma (or semicolon) separated list, numbers are decimal unless prefixed with 0x:
+    //   12                   break when the PC reaches 12
+    //   12 if R3 == 5        break when the instruction at 12 retires, if R3 == 5 just before its writeback
+    //   R3 >= 100            break when R3 is written with a value >= 100
+    //   mem 64-79 rw         break on a read or write of addresses 64..79 (r, w or rw)
+    bool parse(const string& spec, vector<MemoryWatch>& memory_watches, string& error) {
+        stringstream entries(spec);
+        string entry;
+        while (getline(entries, entry, spec.find(';') != string::npos ? ';' : ',')) {
+            vector<string> tokens = tokenize(entry);
+            if (tokens.empty()) continue;
+            entry = entry.substr(entry.find_first_not_of(" \t"));
+            RegisterCondition condition;
+            int pc;
+
+            if (tokens[0] == "mem" && tokens.size() == 3) {
+                MemoryWatch watch;
+                size_t dash = tokens[1].find('-', 1);
+                bool ok = parseNumber(tokens[1].substr(0, dash), watch.low);
+                watch.high = watch.low;
+                if (dash != string::npos) ok = ok && parseNumber(tokens[1].substr(dash + 1), watch.high);
+                const string& kinds = tokens[2];
+                watch.kinds = (kinds.find('r') != string::npos ? WATCH_READ : 0) | (kinds.find('w') != string::npos ? WATCH_WRITE : 0);
+                if (!ok || watch.kinds == 0 || watch.low < 0 || watch.high >= RAM_SIZE || watch.low > watch.high) {
+                    error = "invalid memory watchpoint '" + entry + "'";
+                    return false;
+                }
+                memory_watches.push_back(watch);
+            } else if (parseCondition(tokens, 0, condition)) {
+                addRegisterWatch(condition);
+            } else if (parseNumber(tokens[0], pc) && pc >= 0 && pc < RAM_SIZE) {
+                if (tokens.size() == 1) {
+                    addBreakpoint(pc);
+                } else if (tokens[1] == "if" && parseCondition(tokens, 2, condition)) {
+                    addBreakpoint(pc, condition);
+                } else {
+                    error = "invalid condition in '" + entry + "'";
+                    return false;
+                }
+            } else {
+                error = "invalid breakpoint '" + entry + "'";
+                return false;
+            }
+        }
+        return true;
+    }
+};
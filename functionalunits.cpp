@@ -0,0 +1,178 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <sstream>
+#include <climits>
+#include <cctype>
+#include <algorithm>
+#include "assembler.cpp"
+
+using namespace std;
+
+// functional units behind the EXECUTE stage
+// an instruction issues to a unit of its opcode's type when it leaves EXECUTE; the unit can't take another
+// instruction for the opcode's initiation interval (1 for a pipelined unit, the latency for an unpipelined
+// one), and the result is ready latency cycles after issue. Instructions still complete in order: one whose
+// result isn't ready holds WRITEBACK (and everything behind it), and a dependent instruction waits in
+// DECODE as it always has. With every latency and interval at 1 the timing is the original one.
+
+constexpr int FU_ALU = 0;    // everything not listed below, including address generation and branches
+constexpr int FU_MUL = 1;    // MUL, MULI
+constexpr int FU_DIV = 2;    // DIV, DIVI, MOD, MODI
+constexpr int FU_VECTOR = 3; // VADD, VMUL, VRED
+constexpr int NUM_FU_TYPES = 4;
+constexpr int NUM_OPCODES = 32;
+
+struct FunctionalUnitConfig {
+    int unit_type[NUM_OPCODES];
+    int latency[NUM_OPCODES];  // cycles from issue until the result is ready
+    int interval[NUM_OPCODES]; // cycles the unit is busy before it takes the next instruction
+    int units[NUM_FU_TYPES];   // units of each type
+
+    static const char* unitName(int type) {
+        static const char* names[] = {"alu", "mul", "div", "vector"};
+        return names[type];
+    }
+
+    // one single-cycle unit of each type, the timing the simulator always had
+    static FunctionalUnitConfig singleCycle() {
+        FunctionalUnitConfig config;
+        for (int opcode = 0; opcode < NUM_OPCODES; opcode++) {
+            config.unit_type[opcode] = FU_ALU;
+            config.latency[opcode] = 1;
+            config.interval[opcode] = 1;
+        }
+        config.unit_type[9] = config.unit_type[10] = FU_MUL;
+        config.unit_type[11] = config.unit_type[12] = config.unit_type[13] = config.unit_type[14] = FU_DIV;
+        config.unit_type[27] = config.unit_type[28] = config.unit_type[29] = FU_VECTOR;
+        for (int type = 0; type < NUM_FU_TYPES; type++) config.units[type] = 1;
+        return config;
+    }
+
+    // closer to the hardware: pipelined 3-cycle multiplier, unpipelined 12-cycle divider,
+    // and a vector unit whose multiplier takes a new operation every other cycle
+    static FunctionalUnitConfig realistic() {
+        FunctionalUnitConfig config = singleCycle();
+        config.set(9, 3, 1);
+        config.set(10, 3, 1);
+        for (int opcode = 11; opcode <= 14; opcode++) config.set(opcode, 12, 12);
+        config.set(27, 2, 1); // VADD
+        config.set(28, 4, 2); // VMUL
+        config.set(29, 3, 1); // VRED
+        return config;
+    }
+
+    void set(int opcode, int cycles, int initiation_interval) {
+        latency[opcode] = cycles;
+        interval[opcode] = initiation_interval;
+    }
+
+    // comma separated list, applied in order:
+    //   single | realistic     start from a preset
+    //   MUL=3/1                latency and initiation interval of an opcode (interval defaults to 1)
+    //   mul*2                  number of units of a type (alu, mul, div, vector)
+    bool parse(const string& spec, string& error) {
+        stringstream entries(spec);
+        string entry;
+        while (getline(entries, entry, ',')) {
+            entry.erase(remove_if(entry.begin(), entry.end(), [](char c) { return isspace((unsigned char)c); }), entry.end());
+            if (entry.empty()) continue;
+            size_t equals = entry.find('='), star = entry.find('*');
+            if (entry == "single") {
+                *this = singleCycle();
+            } else if (entry == "realistic") {
+                *this = realistic();
+            } else if (equals != string::npos) {
+                string name = entry.substr(0, equals);
+                transform(name.begin(), name.end(), name.begin(), ::toupper);
+                int opcode = Assembler::opcodeOf(name);
+                int cycles = 0, initiation_interval = 1;
+                size_t slash = entry.find('/', equals);
+                cycles = atoi(entry.substr(equals + 1, slash - equals - 1).c_str());
+                if (slash != string::npos) initiation_interval = atoi(entry.substr(slash + 1).c_str());
+                if (opcode < 0 || opcode >= NUM_OPCODES || cycles < 1 || initiation_interval < 1) {
+                    error = "invalid functional unit timing '" + entry + "'";
+                    return false;
+                }
+                set(opcode, cycles, initiation_interval);
+            } else if (star != string::npos) {
+                string name = entry.substr(0, star);
+                int count = atoi(entry.substr(star + 1).c_str());
+                int type = 0;
+                while (type < NUM_FU_TYPES && name != unitName(type)) type++;
+                if (type == NUM_FU_TYPES || count < 1) {
+                    error = "invalid functional unit count '" + entry + "'";
+                    return false;
+                }
+                units[type] = count;
+            } else {
+                error = "invalid functional unit entry '" + entry + "'";
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+class FunctionalUnitPool {
+private:
+    FunctionalUnitConfig config = FunctionalUnitConfig::singleCycle();
+    vector<int> free_at[NUM_FU_TYPES]; // per unit, first cycle it takes a new instruction
+    long long busy_cycles[NUM_FU_TYPES];
+    int issues[NUM_FU_TYPES];
+    int structural_stalls[NUM_FU_TYPES];
+
+public:
+    FunctionalUnitPool() { reset(); }
+
+    void configure(const FunctionalUnitConfig& new_config) {
+        config = new_config;
+        reset();
+    }
+
+    void reset() {
+        for (int type = 0; type < NUM_FU_TYPES; type++) {
+            free_at[type].assign(config.units[type], 0);
+            busy_cycles[type] = 0;
+            issues[type] = 0;
+            structural_stalls[type] = 0;
+        }
+    }
+
+    // issues opcode in cycle; false (counted as a structural stall) if every unit of its type is busy
+    bool issue(int opcode, int cycle) {
+        int type = config.unit_type[opcode];
+        for (int& free : free_at[type]) {
+            if (free > cycle) continue;
+            free = cycle + config.interval[opcode];
+            busy_cycles[type] += config.interval[opcode];
+            issues[type]++;
+            return true;
+        }
+        structural_stalls[type]++;
+        return false;
+    }
+
+    int latency(int opcode) const { return config.latency[opcode]; }
+    int unitType(int opcode) const { return config.unit_type[opcode]; }
+
+    // first cycle after cycle in which a busy unit frees up, INT_MAX if none is busy
+    int nextFreeCycle(int cycle) const {
+        int next = INT_MAX;
+        for (int type = 0; type < NUM_FU_TYPES; type++)
+            for (int free : free_at[type])
+                if (free > cycle) next = min(next, free);
+        return next;
+    }
+
+    // for cycles the simulator skipped while an instruction was waiting for a unit of type
+    void addStructuralStalls(int type, int cycles) { structural_stalls[type] += cycles; }
+
+    int getUnits(int type) const { return config.units[type]; }
+    int getIssues(int type) const { return issues[type]; }
+    int getStructuralStalls(int type) const { return structural_stalls[type]; }
+    // share of the type's unit-cycles that were busy
+    double getUtilization(int type, int cycles) const {
+        return cycles ? (double)busy_cycles[type] / ((long long)cycles * config.units[type]) : 0;
+    }
+};
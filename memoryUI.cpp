@@ -3,6 +3,7 @@
 #include <vector>
 #include <unordered_map>
 #include <iomanip>
+#include <algorithm>
 
 using namespace std;
 
@@ -15,6 +16,23 @@ constexpr int CACHE_DELAY = 1;
 constexpr int STATUS_WAIT = 0;
 constexpr int STATUS_DONE = 1;
 
+constexpr int WATCH_READ = 1;
+constexpr int WATCH_WRITE = 2;
+
+// configuration policies: RuntimeFlag checks a flag set at construction, Fixed<value> makes the check a
+// compile-time constant so the compiler drops the untaken side entirely
+template <bool Value>
+struct Fixed {
+    Fixed(bool = Value) {}
+    constexpr bool operator()() const { return Value; }
+};
+
+struct RuntimeFlag {
+    bool value;
+    RuntimeFlag(bool flag = true) : value(flag) {}
+    bool operator()() const { return value; }
+};
+
 struct CacheLine {
     bool valid = false;
     bool dirty = false;
@@ -22,35 +40,283 @@ struct CacheLine {
     vector<int> data = vector<int>(WORDS_PER_LINE, 0);
 };
 
+// victim cache entry; the cache is fully associative, so the tag is the whole line number (address / line size)
+struct VictimLine : CacheLine {
+    long long last_use = 0;
+};
+
+constexpr int VICTIM_DELAY = 2; // default cycles to swap a line back from the victim cache
+
+// levels as used by view() and the inspection API
+constexpr int LEVEL_RAM = 0;
+constexpr int LEVEL_CACHE = 1;
+
+// snapshot of one cache line for inspectors
+struct CacheLineView {
+    int line = -1;
+    bool valid = false;
+    bool dirty = false;
+    int tag = -1;
+    int address = -1; // first RAM address the line holds, -1 if invalid
+    vector<int> data;
+};
+
+// a RAM line (address / line size) or cache line modified since the last takeChanges()
+struct LineChange {
+    int level;
+    int line;
+};
+
+// DMA controller, programmed through registers memory mapped at the top of RAM; the registers are never
+// cached, so the pipeline always sees the current status. Writing DMA_CMD_COPY or DMA_CMD_FILL to DMA_CONTROL
+// takes the other registers and starts a transfer, DMA_STATUS reads DMA_BUSY until the last word is written
+constexpr int DMA_BASE = RAM_SIZE - 8;
+constexpr int DMA_SRC = DMA_BASE;          // first source word (copy)
+constexpr int DMA_DST = DMA_BASE + 1;      // first destination word
+constexpr int DMA_COUNT = DMA_BASE + 2;    // words to move
+constexpr int DMA_FILL = DMA_BASE + 3;     // value to fill with (fill)
+constexpr int DMA_CONTROL = DMA_BASE + 4;
+constexpr int DMA_STATUS = DMA_BASE + 5;
+constexpr int DMA_CMD_COPY = 1;
+constexpr int DMA_CMD_FILL = 2;
+constexpr int DMA_IDLE = 0;
+constexpr int DMA_BUSY = 1;
+constexpr int DMA_ERROR = 2;               // bad command, or a range outside RAM or over the registers
+constexpr int DMA_STAGE = 5;               // owner of the memory port while the DMA moves a word
+constexpr int DMA_WORD_CYCLES = MEMORY_DELAY;
+
+// who gets the memory port when the DMA and the pipeline both want it
+constexpr int DMA_POLICY_CPU_FIRST = 0;    // DMA only uses cycles the pipeline left the port idle in
+constexpr int DMA_POLICY_DMA_FIRST = 1;    // DMA takes the port whenever it is free, the pipeline waits for the whole transfer
+constexpr int DMA_POLICY_ROUND_ROBIN = 2;  // the two alternate
+
+// status a command written to DMA_CONTROL leads to (0 is no command); shared by the timed and functional simulators
+inline int dmaCommandStatus(int command, int src, int dst, int count) {
+    if (command == 0) return DMA_IDLE;
+    if (command != DMA_CMD_COPY && command != DMA_CMD_FILL) return DMA_ERROR;
+    if (count < 0 || dst < 0 || dst > DMA_BASE - count) return DMA_ERROR;
+    if (command == DMA_CMD_COPY && (src < 0 || src > DMA_BASE - count)) return DMA_ERROR;
+    return count == 0 ? DMA_IDLE : DMA_BUSY;
+}
+
 struct MemoryResult {
     int status;
     int value;
 };
 
-class MemorySystem {
+template <class CachePolicy, int Lines = CACHE_LINES, int LineWords = WORDS_PER_LINE>
+class BasicMemorySystem {
 private:
     vector<int> ram;
     vector<CacheLine> cache;
     int cycle_count = 0;
     int memory_access_stage = -1;
-    bool useCache;
+    CachePolicy useCache;
     bool accessing_cache = false;
     bool accessing_ram = false;
 
     int hits = 0;
     int misses = 0;
 
+    // optional victim cache behind the direct-mapped cache, see setVictimCache(); empty when off
+    vector<VictimLine> victims;
+    int victim_delay = VICTIM_DELAY;
+    long long victim_clock = 0; // LRU stamps
+    int victim_hits = 0;        // read misses served from the victim cache
+    int victim_write_hits = 0;  // write misses that updated a line in the victim cache
+    int victim_writebacks = 0;  // dirty lines written to RAM when they left the victim cache
+
+    // memory watchpoints, one byte of WATCH_* flags per address (left empty when nothing is watched)
+    vector<unsigned char> watch_map;
+    bool watch_hit = false;
+    int watch_address = -1;
+    int watch_kind = 0;
+    int watch_value = 0;
+
+    // change log for inspectors, see trackChanges(); each line is logged at most once between takes
+    bool tracking = false;
+    vector<unsigned char> ram_line_changed;
+    vector<unsigned char> cache_line_changed;
+    vector<LineChange> changes;
+
+    // DMA engine, see dmaStartOfCycle(); a transfer holds the port as the access of DMA_STAGE
+    int dma_policy = DMA_POLICY_CPU_FIRST;
+    bool dma_active = false;
+    int dma_command = 0;
+    int dma_src = 0, dma_dst = 0, dma_remaining = 0, dma_fill_value = 0;
+    bool dma_had_port = false;  // the DMA got the port last, for round robin
+    vector<int> dma_written;    // destination words since the last takeDmaWrites()
+    int dma_words = 0;
+    long long dma_port_cycles = 0;
+    int dma_conflicts = 0;      // pipeline accesses turned away because the DMA held the port
+
+    // whether stage has to wait for the port: another stage or the DMA holds it, or the policy gives the DMA the next turn
+    bool portBusyFor(int stage) {
+        if (accessing_cache || accessing_ram) {
+            if (memory_access_stage == stage) return false;
+            if (memory_access_stage == DMA_STAGE) dma_conflicts++;
+            return true;
+        }
+        if (dma_active && (dma_policy == DMA_POLICY_DMA_FIRST || (dma_policy == DMA_POLICY_ROUND_ROBIN && !dma_had_port))) {
+            dma_conflicts++;
+            return true;
+        }
+        return false;
+    }
+
+    void markChanged(int level, int line) {
+        if (!tracking) return;
+        vector<unsigned char>& flags = level == LEVEL_RAM ? ram_line_changed : cache_line_changed;
+        if (flags[line]) return;
+        flags[line] = 1;
+        changes.push_back({level, line});
+    }
+
+    void checkWatch(int address, int kind, int value) {
+        if (watch_map.empty() || !(watch_map[address] & kind) || watch_hit) return;
+        watch_hit = true;
+        watch_address = address;
+        watch_kind = kind;
+        watch_value = value;
+    }
+
+    // slot holding line number line_number, -1 if none (always -1 without a victim cache)
+    int findVictim(int line_number) const {
+        for (int slot = 0; slot < (int)victims.size(); slot++)
+            if (victims[slot].valid && victims[slot].tag == line_number) return slot;
+        return -1;
+    }
+
+    // a valid line leaving the direct-mapped cache; without a victim cache a dirty one is written back at once,
+    // otherwise it takes a free or the least recently used slot, writing back the line that was there if dirty
+    void evictLine(const CacheLine& line, int line_number) {
+        if (victims.empty()) {
+            if (!line.dirty) return;
+            for (int i = 0; i < LineWords; i++) ram[line_number * LineWords + i] = line.data[i];
+            markChanged(LEVEL_RAM, line_number);
+            return;
+        }
+        int slot = 0;
+        for (int i = 0; i < (int)victims.size(); i++) {
+            if (!victims[i].valid) {
+                slot = i;
+                break;
+            }
+            if (victims[i].last_use < victims[slot].last_use) slot = i;
+        }
+        VictimLine& victim = victims[slot];
+        if (victim.valid && victim.dirty) {
+            for (int i = 0; i < LineWords; i++) ram[victim.tag * LineWords + i] = victim.data[i];
+            markChanged(LEVEL_RAM, victim.tag);
+            victim_writebacks++;
+        }
+        victim.valid = true;
+        victim.dirty = line.dirty;
+        victim.tag = line_number;
+        victim.data = line.data;
+        victim.last_use = ++victim_clock;
+    }
+
+    // whether the line holding address may be cached: none that overlaps the DMA registers is, whatever the
+    // line size, so a store to DMA_CONTROL always reaches RAM (and starts the transfer) instead of hitting a line
+    bool cacheable(int address) const {
+        return (address / LineWords + 1) * LineWords <= DMA_BASE;
+    }
+
+    // brings the line holding address into the direct-mapped cache, from the victim cache if it is there
+    // (swapping it with the line it replaces) and from RAM otherwise; returns whether it came from the victim cache
+    bool fillLine(int address) {
+        int line_number = address / LineWords;
+        int line_index = line_number % Lines;
+        CacheLine& line = cache[line_index];
+        int evicted_number = line.tag * Lines + line_index;
+        int slot = findVictim(line_number);
+        if (slot != -1) {
+            VictimLine& victim = victims[slot];
+            CacheLine evicted = line;
+            line.dirty = victim.dirty;
+            line.data.swap(victim.data);
+            victim.valid = evicted.valid;
+            victim.dirty = evicted.dirty;
+            victim.tag = evicted_number;
+            victim.data.swap(evicted.data);
+            victim.last_use = ++victim_clock;
+        } else {
+            if (line.valid) evictLine(line, evicted_number);
+            line.dirty = false;
+            for (int i = 0; i < LineWords; i++) line.data[i] = ram[line_number * LineWords + i];
+        }
+        markChanged(LEVEL_CACHE, line_index);
+        line.valid = true;
+        line.tag = address / (Lines * LineWords);
+        return slot != -1;
+    }
+
+    // a pipeline store reached the DMA registers; commands while a transfer is running are ignored
+    void dmaRegisterWritten(int address) {
+        if (address != DMA_CONTROL || dma_active) return;
+        int status = dmaCommandStatus(ram[DMA_CONTROL], ram[DMA_SRC], ram[DMA_DST], ram[DMA_COUNT]);
+        if (status == DMA_BUSY) {
+            dma_active = true;
+            dma_command = ram[DMA_CONTROL];
+            dma_src = ram[DMA_SRC];
+            dma_dst = ram[DMA_DST];
+            dma_remaining = ram[DMA_COUNT];
+            dma_fill_value = ram[DMA_FILL];
+        }
+        ram[DMA_STATUS] = status;
+        markChanged(LEVEL_RAM, DMA_STATUS / LineWords);
+    }
+
+    void startDmaWord(int cycles) {
+        accessing_ram = true;
+        accessing_cache = false;
+        memory_access_stage = DMA_STAGE;
+        cycle_count = cycles;
+        dma_port_cycles += DMA_WORD_CYCLES;
+    }
+
+    // moves one word straight to RAM; the source is read through the cache and a cached copy of the
+    // destination is updated too, so neither side sees stale data
+    void finishDmaWord() {
+        int value = dma_command == DMA_CMD_COPY ? peek(dma_src++) : dma_fill_value;
+        int address = dma_dst++;
+        ram[address] = value;
+        markChanged(LEVEL_RAM, address / LineWords);
+        int line_index = (address / LineWords) % Lines;
+        if (useCache() && cache[line_index].valid && cache[line_index].tag == address / (Lines * LineWords)) {
+            cache[line_index].data[address % LineWords] = value;
+            markChanged(LEVEL_CACHE, line_index);
+        }
+        int slot = findVictim(address / LineWords);
+        if (slot != -1) victims[slot].data[address % LineWords] = value;
+        checkWatch(address, WATCH_WRITE, value);
+        dma_written.push_back(address);
+        dma_words++;
+        if (--dma_remaining > 0) return;
+        dma_active = false;
+        ram[DMA_STATUS] = DMA_IDLE;
+        markChanged(LEVEL_RAM, DMA_STATUS / LineWords);
+    }
+
 public:
-    MemorySystem(bool cache) : ram(RAM_SIZE, 0), cache(CACHE_LINES), useCache(cache) {}
-    MemorySystem() : ram(RAM_SIZE, 0), cache(CACHE_LINES) {}
+    BasicMemorySystem(bool cache_on = true) : ram(RAM_SIZE, 0), cache(Lines), useCache(cache_on) {
+        for (CacheLine& line : cache) line.data.assign(LineWords, 0);
+    }
 
     MemoryResult write(int address, int value, int stage) {
-        if ((accessing_cache || accessing_ram) && memory_access_stage != stage) return {STATUS_WAIT, 0}; // memory occupied
-        int line_index = (address / WORDS_PER_LINE) % CACHE_LINES;
-        int tag = address / (CACHE_LINES * WORDS_PER_LINE);
-        int offset = address % WORDS_PER_LINE;
+        return writeWords(address, &value, 1, stage);
+    }
+
+    // writes count words from address on in one access; they have to be within one line
+    // (used for single words and for vector stores), same timing as a single-word write
+    MemoryResult writeWords(int address, const int* values, int count, int stage) {
+        if (portBusyFor(stage)) return {STATUS_WAIT, 0}; // memory occupied
+        int line_index = (address / LineWords) % Lines;
+        int tag = address / (Lines * LineWords);
+        int offset = address % LineWords;
 
-        if (useCache && cache[line_index].valid && cache[line_index].tag == tag) { // in cache
+        if (useCache() && cache[line_index].valid && cache[line_index].tag == tag) { // in cache
             if (!accessing_cache) {
                 accessing_cache = true;
                 accessing_ram = false;
@@ -61,8 +327,11 @@ public:
                 cycle_count--;
                 if (cycle_count == 0) {
                     accessing_cache = false;
-                    cache[line_index].data[offset] = value;
+                    dma_had_port = false;
+                    for (int i = 0; i < count; i++) cache[line_index].data[offset + i] = values[i];
                     cache[line_index].dirty = true;
+                    markChanged(LEVEL_CACHE, line_index);
+                    for (int i = 0; i < count; i++) checkWatch(address + i, WATCH_WRITE, values[i]);
                     return {STATUS_DONE, 0};
                 }
                 return {STATUS_WAIT, 0};
@@ -71,14 +340,28 @@ public:
             if (!accessing_ram) {
                 accessing_ram = true;
                 accessing_cache = false;
-                cycle_count = MEMORY_DELAY;
+                cycle_count = findVictim(address / LineWords) != -1 ? victim_delay : MEMORY_DELAY;
                 memory_access_stage = stage;
                 return {STATUS_WAIT, 0};
             } else {
                 cycle_count--;
                 if (cycle_count == 0) {
                     accessing_ram = false;
-                    ram[address] = value;
+                    dma_had_port = false;
+                    int slot = findVictim(address / LineWords);
+                    if (slot != -1) { // the line is in the victim cache, which keeps it (dirty) instead of RAM
+                        for (int i = 0; i < count; i++) victims[slot].data[offset + i] = values[i];
+                        victims[slot].dirty = true;
+                        victims[slot].last_use = ++victim_clock;
+                        victim_write_hits++;
+                        for (int i = 0; i < count; i++) checkWatch(address + i, WATCH_WRITE, values[i]);
+                        return {STATUS_DONE, 0};
+                    }
+                    for (int i = 0; i < count; i++) ram[address + i] = values[i];
+                    markChanged(LEVEL_RAM, address / LineWords);
+                    for (int i = 0; i < count; i++) checkWatch(address + i, WATCH_WRITE, values[i]);
+                    for (int i = 0; i < count; i++)
+                        if (address + i >= DMA_BASE) dmaRegisterWritten(address + i);
                     return {STATUS_DONE, 0};
                 }
                 return {STATUS_WAIT, 0};
@@ -87,12 +370,12 @@ public:
     }
 
     MemoryResult read(int address, int stage) {
-        if ((accessing_cache || accessing_ram) && memory_access_stage != stage) return {STATUS_WAIT, 0}; // memory occupied
-        int line_index = (address / WORDS_PER_LINE) % CACHE_LINES;
-        int tag = address / (CACHE_LINES * WORDS_PER_LINE);
-        int offset = address % WORDS_PER_LINE;
+        if (portBusyFor(stage)) return {STATUS_WAIT, 0}; // memory occupied
+        int line_index = (address / LineWords) % Lines;
+        int tag = address / (Lines * LineWords);
+        int offset = address % LineWords;
 
-        if (useCache && cache[line_index].valid && cache[line_index].tag == tag) {
+        if (useCache() && cache[line_index].valid && cache[line_index].tag == tag) {
             // cout << "Cache hit!" << endl;
             if (!accessing_cache) {
                 accessing_cache = true;
@@ -104,7 +387,9 @@ public:
                 cycle_count--;
                 if (cycle_count == 0) {
                     accessing_cache = false;
+                    dma_had_port = false;
                     hits++; // update hits
+                    checkWatch(address, WATCH_READ, cache[line_index].data[offset]);
                     return {STATUS_DONE, cache[line_index].data[offset]};
                 }
                 return {STATUS_WAIT, 0};
@@ -113,29 +398,21 @@ public:
             if (!accessing_ram) {
                 accessing_ram = true;
                 accessing_cache = false;
-                cycle_count = MEMORY_DELAY;
+                cycle_count = useCache() && findVictim(address / LineWords) != -1 ? victim_delay : MEMORY_DELAY;
                 memory_access_stage = stage;
                 return {STATUS_WAIT, 0};
             } else {
                 cycle_count--;
                 if (cycle_count == 0) {
                     accessing_ram = false;
-                    if (useCache) {
-                        if (cache[line_index].dirty) { 
-                            int oldaddr = (cache[line_index].tag * (CACHE_LINES * WORDS_PER_LINE)) + (line_index * WORDS_PER_LINE);
-                            for (int i = 0; i < WORDS_PER_LINE; i++) {
-                                ram[((oldaddr / WORDS_PER_LINE) * WORDS_PER_LINE) + i] = cache[line_index].data[i];
-                            }
-                        }
-                        cache[line_index].valid = true;
-                        cache[line_index].tag = tag;
-                        cache[line_index].dirty = false;
-                        for (int i = 0; i < WORDS_PER_LINE; i++) {
-                            cache[line_index].data[i] = ram[((address / WORDS_PER_LINE) * WORDS_PER_LINE) + i];
-                        }
+                    dma_had_port = false;
+                    if (useCache() && cacheable(address)) {
+                        if (fillLine(address)) victim_hits++;
                         misses++; // update misses
+                        checkWatch(address, WATCH_READ, cache[line_index].data[offset]);
                         return {STATUS_DONE, cache[line_index].data[offset]};
                     } else {
+                        checkWatch(address, WATCH_READ, ram[address]);
                         return {STATUS_DONE, ram[address]};
                     }
                 }
@@ -144,27 +421,130 @@ public:
         }
     }
 
+    // same timing as read(), but on completion also returns the whole line holding address
+    // (used by the fetch queue and vector loads), and every word of it counts as read for watchpoints
+    MemoryResult readLine(int address, int stage, vector<int>& words) {
+        MemoryResult res = read(address, stage);
+        if (res.status == STATUS_DONE) {
+            int base = address / LineWords * LineWords;
+            words.resize(LineWords);
+            for (int i = 0; i < LineWords; i++) {
+                words[i] = peek(base + i);
+                if (base + i != address) checkWatch(base + i, WATCH_READ, words[i]);
+            }
+        }
+        return res;
+    }
+
     void view(int level, int line) {
-        if (level == 1 && line < CACHE_LINES) {
-            cout << "Cache Line " << line << " [Valid: " << cache[line].valid
-                 << ", Tag: " << cache[line].tag << ", Dirty: " << cache[line].dirty << "] - ";
-            for (int i : cache[line].data) cout << i << " ";
+        if (level == LEVEL_CACHE && line >= 0 && line < Lines) {
+            CacheLineView view = inspectCacheLine(line);
+            cout << "Cache Line " << line << " [Valid: " << view.valid
+                 << ", Tag: " << view.tag << ", Dirty: " << view.dirty << "] - ";
+            for (int i : view.data) cout << i << " ";
             cout << endl;
-        } else if (level == 0 && line < RAM_SIZE / WORDS_PER_LINE) {
+        } else if (level == LEVEL_RAM && line >= 0 && line < RAM_SIZE / LineWords) {
             cout << "RAM Line " << line << " - ";
-            for (int i = 0; i < WORDS_PER_LINE; i++)
-                cout << ram[line * WORDS_PER_LINE + i] << " ";
+            for (int i : inspectRam(line * LineWords, LineWords)) cout << i << " ";
             cout << endl;
         } else {
             cout << "Invalid view command" << endl;
         }
     }
 
+    CacheLineView inspectCacheLine(int line) const {
+        CacheLineView view;
+        if (line < 0 || line >= Lines) return view;
+        const CacheLine& cached = cache[line];
+        view.line = line;
+        view.valid = cached.valid;
+        view.dirty = cached.dirty;
+        view.tag = cached.tag;
+        if (cached.valid) view.address = cached.tag * (Lines * LineWords) + line * LineWords;
+        view.data = cached.data;
+        return view;
+    }
+
+    // RAM contents as stored (a dirty cached line may be newer, see peek()), clipped to RAM
+    vector<int> inspectRam(int address, int count) const {
+        int first = max(address, 0);
+        int last = min(address + count, RAM_SIZE);
+        if (first >= last) return vector<int>();
+        return vector<int>(ram.begin() + first, ram.begin() + last);
+    }
+
+    // starts (or stops) logging which lines change, so an inspector only has to re-read those
+    void trackChanges(bool on) {
+        tracking = on;
+        ram_line_changed.assign(on ? RAM_SIZE / LineWords : 0, 0);
+        cache_line_changed.assign(on ? Lines : 0, 0);
+        changes.clear();
+    }
+
+    // lines changed since the last call, in the order they first changed
+    vector<LineChange> takeChanges() {
+        for (const LineChange& change : changes)
+            (change.level == LEVEL_RAM ? ram_line_changed : cache_line_changed)[change.line] = 0;
+        vector<LineChange> taken;
+        taken.swap(changes);
+        return taken;
+    }
+
+    int getCacheLines() const { return Lines; }
+    int getLineWords() const { return LineWords; }
+
+    void watch(int low, int high, int kinds) {
+        if (watch_map.empty()) watch_map.assign(RAM_SIZE, 0);
+        for (int address = low; address <= high; address++) watch_map[address] |= kinds;
+    }
+
+    void clearWatches() {
+        watch_map.clear();
+        watch_hit = false;
+    }
+
+    // the first watched access since the last clearWatchHit(), if any
+    bool hasWatchHit() const { return watch_hit; }
+    void clearWatchHit() { watch_hit = false; }
+    int getWatchAddress() const { return watch_address; }
+    int getWatchKind() const { return watch_kind; }
+    int getWatchValue() const { return watch_value; }
+
+    // cycles left on the access in progress (0 if the memory is idle)
+    int pendingCycles() const { return (accessing_cache || accessing_ram) ? cycle_count : 0; }
+
+    // whether stage started the access in progress and still has to follow it through
+    bool busyFor(int stage) const { return (accessing_cache || accessing_ram) && memory_access_stage == stage; }
+
+    // advances the access in progress as if its stage had retried it for that many cycles without finishing
+    void skipCycles(int cycles) { cycle_count -= cycles; }
+
+    // value a load would currently see (cache first if the line is present), without any timing
+    int peek(int address) const {
+        int line_index = (address / LineWords) % Lines;
+        int tag = address / (Lines * LineWords);
+        if (useCache() && cache[line_index].valid && cache[line_index].tag == tag)
+            return cache[line_index].data[address % LineWords];
+        int slot = findVictim(address / LineWords);
+        if (slot != -1) return victims[slot].data[address % LineWords];
+        return ram[address];
+    }
+
+    // puts a line in the cache the way a completed access would, but with no timing and no hit/miss counts
+    // writes don't allocate, same as write(); used to warm the cache before a sampled interval
+    void warm(int address, bool write) {
+        int line_index = (address / LineWords) % Lines;
+        int tag = address / (Lines * LineWords);
+        if (!useCache() || write || !cacheable(address) || (cache[line_index].valid && cache[line_index].tag == tag)) return;
+        fillLine(address);
+    }
+
     // for testing/demoing, please leave these here until we begin to start on full demo
 
     void forceWrite(int address, int value) {
         if (address >= 0 && address < RAM_SIZE) {
             ram[address] = value;
+            markChanged(LEVEL_RAM, address / LineWords);
         }
     }
 
@@ -175,6 +555,73 @@ public:
         return 0;
     }
 
+    // DMA side of the memory port, called by the simulator at the start and at the end of every cycle, the
+    // pipeline stages use the port in between; a word transfer holds the port for DMA_WORD_CYCLES cycles
+    void dmaStartOfCycle() {
+        if (!dma_active) return;
+        if (accessing_ram && memory_access_stage == DMA_STAGE) {
+            if (--cycle_count > 0) return;
+            accessing_ram = false;
+            dma_had_port = true;
+            finishDmaWord();
+            if (!dma_active) return;
+        } else if (accessing_cache || accessing_ram) {
+            return;
+        }
+        if (dma_policy == DMA_POLICY_DMA_FIRST || (dma_policy == DMA_POLICY_ROUND_ROBIN && !dma_had_port))
+            startDmaWord(DMA_WORD_CYCLES);
+    }
+
+    // any policy takes a port the pipeline left idle; started here, the transfer holds it from the next cycle on
+    void dmaEndOfCycle() {
+        if (dma_active && !accessing_cache && !accessing_ram) startDmaWord(DMA_WORD_CYCLES + 1);
+    }
+
+    // drops a transfer in progress (used when the simulator restarts execution)
+    void resetDma() {
+        if (dma_active && memory_access_stage == DMA_STAGE) accessing_ram = false;
+        dma_active = false;
+        dma_had_port = false;
+        dma_written.clear();
+        dma_words = 0;
+        dma_port_cycles = 0;
+        dma_conflicts = 0;
+    }
+
+    void setDmaPolicy(int policy) { dma_policy = policy; }
+    bool dmaActive() const { return dma_active; }
+
+    // destination addresses the DMA wrote since the last call
+    vector<int> takeDmaWrites() {
+        vector<int> written;
+        written.swap(dma_written);
+        return written;
+    }
+
+    // entries 0 (the default) turns the victim cache off; a line it holds is swapped back in latency cycles.
+    // Lines in it are written back first, so nothing is lost when it shrinks
+    void setVictimCache(int entries, int latency = VICTIM_DELAY) {
+        for (const VictimLine& victim : victims) {
+            if (!victim.valid || !victim.dirty) continue;
+            for (int i = 0; i < LineWords; i++) ram[victim.tag * LineWords + i] = victim.data[i];
+            markChanged(LEVEL_RAM, victim.tag);
+        }
+        victims.assign(max(0, entries), VictimLine());
+        for (VictimLine& victim : victims) victim.data.assign(LineWords, 0);
+        victim_delay = max(1, latency);
+        victim_hits = victim_write_hits = victim_writebacks = 0;
+    }
+
     int getHits() const { return hits; }
     int getMisses() const { return misses; }
+    int getVictimEntries() const { return (int)victims.size(); }
+    int getVictimHits() const { return victim_hits; }
+    int getVictimWriteHits() const { return victim_write_hits; }
+    int getVictimWritebacks() const { return victim_writebacks; }
+    int getDmaWords() const { return dma_words; }
+    long long getDmaPortCycles() const { return dma_port_cycles; }
+    int getDmaConflicts() const { return dma_conflicts; }
 };
+
+// the cache is switched at runtime and has the default geometry
+typedef BasicMemorySystem<RuntimeFlag> MemorySystem;
@@ -0,0 +1,221 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+#include "blocktranslator.cpp"
+#include "xorshift.cpp"
+
+using namespace std;
+
+// SimPoint-style sampled simulation:
+// 1. run the program on FunctionalSimulator and collect a basic-block vector (instructions per block)
+//    for every fixed-length interval
+// 2. randomly project the vectors down to a few dimensions and cluster them with k-means
+// 3. simulate only the interval closest to each cluster centre on Simulator, after warming the cache
+//    with the accesses of the instructions just before it, and weight the results by cluster size
+
+struct SimPointConfig {
+    long long interval = 100;     // instructions per interval
+    int max_clusters = 5;
+    long long warmup = 200;       // instructions of functional cache warm-up before each sample
+    int projected_dims = 15;
+    unsigned int seed = 1;
+    long long max_instructions = 100000000; // profiling gives up after this many
+};
+
+struct SimPointSample {
+    int interval = 0;      // index of the representative interval
+    int cluster_size = 0;  // intervals it stands for
+    double weight = 0;     // fraction of all instructions it stands for
+    int instructions = 0;  // measured in detail
+    int cycles = 0;
+    int hits = 0;
+    int misses = 0;
+};
+
+struct SimPointResult {
+    string error; // empty on success
+    long long total_instructions = 0;
+    int intervals = 0;
+    long long detailed_instructions = 0;
+    vector<SimPointSample> samples;
+    double cpi = 0;       // extrapolated
+    double hit_rate = 0;  // extrapolated, 0..1
+};
+
+class SimPointSampler {
+private:
+    typedef vector<pair<int, long long>> BlockVector;
+
+    // fixed random projection matrix entry in [-1, 1] for a block address and output dimension
+    static double projection(int block, int dim, unsigned int seed) {
+        unsigned int state = (unsigned int)block * 2654435761u ^ (unsigned int)(dim + 1) * 40503u ^ seed;
+        if (state == 0) state = 1;
+        nextRandom(state);
+        return (nextRandom(state) % 2001) / 1000.0 - 1.0;
+    }
+
+    static double distance(const vector<double>& a, const vector<double>& b) {
+        double sum = 0;
+        for (size_t i = 0; i < a.size(); i++) sum += (a[i] - b[i]) * (a[i] - b[i]);
+        return sum;
+    }
+
+    // k-means with k-means++ seeding, returns the cluster of each point
+    static vector<int> cluster(const vector<vector<double>>& points, int k, unsigned int seed) {
+        unsigned int state = seed ? seed : 1;
+        vector<vector<double>> centres;
+        centres.push_back(points[nextRandom(state) % points.size()]);
+        while ((int)centres.size() < k) {
+            vector<double> nearest(points.size());
+            double total = 0;
+            for (size_t i = 0; i < points.size(); i++) {
+                nearest[i] = distance(points[i], centres[0]);
+                for (const auto& centre : centres) nearest[i] = min(nearest[i], distance(points[i], centre));
+                total += nearest[i];
+            }
+            if (total == 0) break; // fewer distinct points than clusters
+            double pick = nextUnit(state) * total;
+            size_t chosen = 0;
+            for (; chosen + 1 < points.size() && pick >= nearest[chosen]; chosen++) pick -= nearest[chosen];
+            centres.push_back(points[chosen]);
+        }
+
+        vector<int> assignment(points.size(), -1);
+        for (int iteration = 0; iteration < 100; iteration++) {
+            bool changed = false;
+            for (size_t i = 0; i < points.size(); i++) {
+                int best = 0;
+                for (size_t c = 1; c < centres.size(); c++)
+                    if (distance(points[i], centres[c]) < distance(points[i], centres[best])) best = (int)c;
+                if (assignment[i] != best) {
+                    assignment[i] = best;
+                    changed = true;
+                }
+            }
+            if (!changed) break;
+            for (size_t c = 0; c < centres.size(); c++) {
+                vector<double> sum(points[0].size(), 0.0);
+                int members = 0;
+                for (size_t i = 0; i < points.size(); i++) {
+                    if (assignment[i] != (int)c) continue;
+                    for (size_t d = 0; d < sum.size(); d++) sum[d] += points[i][d];
+                    members++;
+                }
+                if (members == 0) continue; // keep the old centre, it may pick up points again
+                for (double& value : sum) value /= members;
+                centres[c] = sum;
+            }
+        }
+        return assignment;
+    }
+
+public:
+    static SimPointResult sample(const vector<unsigned int>& program, bool pipeline, bool cache, const SimPointConfig& config) {
+        SimPointResult result;
+
+        // profiling pass
+        vector<BlockVector> vectors;
+        vector<long long> lengths;
+        FunctionalSimulator profiler;
+        profiler.loadProgram(program);
+        profiler.enableBlockProfile();
+        while (!profiler.isHalted() && result.total_instructions < config.max_instructions) {
+            long long ran = profiler.run(config.interval);
+            if (ran == 0) break;
+            vectors.push_back(profiler.takeBlockProfile());
+            lengths.push_back(ran);
+            result.total_instructions += ran;
+        }
+        if (!profiler.isHalted() || profiler.isFaulted()) {
+            result.error = profiler.isFaulted() ? "program accessed memory outside RAM" : "program did not halt within the instruction limit";
+            return result;
+        }
+        result.intervals = (int)vectors.size();
+        if (vectors.empty()) {
+            result.error = "program retired no instructions";
+            return result;
+        }
+
+        // normalise each vector to its interval length and project it down
+        vector<vector<double>> points;
+        for (size_t i = 0; i < vectors.size(); i++) {
+            vector<double> point(config.projected_dims, 0.0);
+            for (const auto& entry : vectors[i]) {
+                double share = (double)entry.second / lengths[i];
+                for (int d = 0; d < config.projected_dims; d++) point[d] += share * projection(entry.first, d, config.seed);
+            }
+            points.push_back(point);
+        }
+
+        int k = min(config.max_clusters, (int)points.size());
+        vector<int> assignment = cluster(points, k, config.seed);
+
+        // the member closest to each centre represents the cluster
+        for (int c = 0; c < k; c++) {
+            vector<double> centre(config.projected_dims, 0.0);
+            long long cluster_instructions = 0;
+            int members = 0;
+            for (size_t i = 0; i < points.size(); i++) {
+                if (assignment[i] != c) continue;
+                for (int d = 0; d < config.projected_dims; d++) centre[d] += points[i][d];
+                cluster_instructions += lengths[i];
+                members++;
+            }
+            if (members == 0) continue;
+            for (double& value : centre) value /= members;
+            int best = -1;
+            for (size_t i = 0; i < points.size(); i++)
+                if (assignment[i] == c && (best < 0 || distance(points[i], centre) < distance(points[best], centre))) best = (int)i;
+
+            SimPointSample sample;
+            sample.interval = best;
+            sample.cluster_size = members;
+            sample.weight = (double)cluster_instructions / result.total_instructions;
+            result.samples.push_back(sample);
+        }
+        sort(result.samples.begin(), result.samples.end(),
+             [](const SimPointSample& a, const SimPointSample& b) { return a.interval < b.interval; });
+
+        // detailed pass, fast-forwarding functionally between samples
+        FunctionalSimulator forward;
+        forward.loadProgram(program);
+        long long position = 0;
+        vector<MemoryAccess> trace;
+        for (SimPointSample& sample : result.samples) {
+            long long start = sample.interval * config.interval;
+            long long warm_start = max(position, start - config.warmup);
+            forward.run(warm_start - position);
+            trace.clear();
+            forward.setAccessTrace(&trace);
+            forward.run(start - warm_start);
+            forward.setAccessTrace(nullptr);
+            position = start;
+
+            Simulator sim(pipeline, cache);
+            sim.loadState(forward.getRegisters(), forward.getMemory(), forward.getProgramCounter(), forward.getVectorRegisters());
+            for (const MemoryAccess& access : trace) sim.warmCache(access.address, access.write);
+            while (sim.getInstructionCount() < lengths[sample.interval])
+                if (sim.run(1) == FLAG_HALT) break;
+
+            sample.instructions = sim.getInstructionCount();
+            sample.cycles = sim.getCycleCount();
+            sample.hits = sim.getCacheHits();
+            sample.misses = sim.getCacheMisses();
+            result.detailed_instructions += sample.instructions;
+        }
+
+        // weighted per-instruction rates
+        double accesses = 0, hits = 0;
+        for (const SimPointSample& sample : result.samples) {
+            if (sample.instructions == 0) continue;
+            result.cpi += sample.weight * sample.cycles / sample.instructions;
+            hits += sample.weight * sample.hits / sample.instructions;
+            accesses += sample.weight * (sample.hits + sample.misses) / sample.instructions;
+        }
+        result.hit_rate = accesses > 0 ? hits / accesses : 0;
+        return result;
+    }
+};
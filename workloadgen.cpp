@@ -0,0 +1,163 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include "assembler.cpp"
+#include "memoryUI.cpp"
+#include "xorshift.cpp"
+
+using namespace std;
+
+// synthetic memory-system workloads for this ISA, reproducible from a seed
+// the generated loop walks a working set of working_set words:
+//  - sequential: index advances by stride each access, wrapping at the end of the working set
+//  - random: pointer chase through a random single-cycle permutation of the working set, stored
+//    in the image itself (each element holds the index of the next one), so no MOD is needed
+// each access slot is a load or a store (in random mode a store is a read-modify-write of the chased
+// element, because the next address lives in it), optionally followed by a chain of dependent ALU ops,
+// and optionally followed by a branch (taken or not, chosen per slot at generation time)
+
+struct WorkloadParams {
+    int working_set = 256;      // words
+    int stride = 1;             // words between consecutive accesses
+    bool random = false;
+    int accesses = 10000;       // total memory accesses (rounded up to whole loop iterations)
+    double load_fraction = 1.0; // share of access slots that are loads
+    int chain_length = 0;       // dependent ALU ops after each access
+    double branch_density = 0;  // chance of a branch after each access slot
+    int unroll = 4;             // access slots per loop iteration
+    unsigned int seed = 1;
+};
+
+struct GeneratedWorkload {
+    string source;              // assembly for the code part of the image
+    vector<unsigned int> image; // code, padding, then the working set
+    int data_base = 0;
+    string error;               // empty on success
+};
+
+class WorkloadGenerator {
+private:
+    static string hex(long long value) {
+        ostringstream out;
+        out << std::hex << uppercase << value;
+        return out.str();
+    }
+
+    struct Emitter {
+        ostringstream out;
+        string pending_label;
+        int label_count = 0;
+
+        // labels are written on the same line as the next instruction, like the hand-written benchmarks
+        void emit(const string& inst) {
+            if (!pending_label.empty()) out << pending_label << " ";
+            out << inst << "\n";
+            pending_label.clear();
+        }
+        string newLabel(const string& prefix) { return prefix + to_string(label_count++); }
+    };
+
+    static string generateCode(const WorkloadParams& p, int working_set, int data_base, int iterations, unsigned int state) {
+        Emitter e;
+        e.out << "# generated workload: working_set=" << p.working_set << " stride=" << p.stride
+              << (p.random ? " random" : " sequential") << " accesses=" << p.accesses << " loads=" << p.load_fraction
+              << " chain=" << p.chain_length << " branches=" << p.branch_density << " unroll=" << p.unroll
+              << " seed=" << p.seed << "\n";
+        e.emit("LOADI R1 " + hex(data_base) + "           # working set base");
+        e.emit("LOADI R2 " + hex(working_set) + "           # working set size");
+        e.emit("LOADI R3 1");
+        e.emit("LOADI R4 " + hex((long long)p.stride * p.unroll) + "           # index step per iteration");
+        e.emit("LOADI R5 0           # index");
+        e.emit("LOADI R6 0           # iteration counter");
+        e.emit("LOADI R7 " + hex(iterations) + "           # iterations");
+        e.pending_label = "loop";
+
+        for (int slot = 0; slot < p.unroll; slot++) {
+            bool load = nextUnit(state) < p.load_fraction;
+            if (p.random) {
+                // R5 = array[R5] moves to the next element; a store writes the loaded link back
+                e.emit("ADD R10 R5 R0 0");
+                e.emit("LOAD R5 R1 R10 0");
+                if (!load) e.emit("STR R5 R1 R10 0");
+                if (p.chain_length > 0) e.emit("ADD R8 R5 R3 0");
+            } else {
+                string offset = hex((long long)slot * p.stride);
+                if (load) e.emit("LOAD R8 R1 R5 " + offset);
+                else e.emit("STR R8 R1 R5 " + offset);
+                if (p.chain_length > 0) e.emit("ADD R8 R8 R3 0");
+            }
+            for (int i = 1; i < p.chain_length; i++) e.emit("ADD R8 R8 R3 0");
+
+            if (nextUnit(state) < p.branch_density) {
+                string target = e.newLabel("b");
+                // R0 == R0 is always taken (to the next instruction), R0 == R3 never is
+                e.emit(string(nextUnit(state) < 0.5 ? "BRN R0 R0 0 " : "BRN R0 R3 0 ") + target);
+                e.pending_label = target;
+            }
+        }
+
+        if (!p.random) {
+            string wrapped = e.newLabel("w");
+            e.emit("ADD R5 R5 R4 0");
+            e.emit("BRN R5 R2 1 " + wrapped + "           # wrap at the end of the working set");
+            e.emit("SUB R5 R5 R2 0");
+            e.pending_label = wrapped;
+        }
+        e.emit("ADD R6 R6 R3 0");
+        e.emit("BRN R6 R7 1 loop");
+        e.emit("HALT");
+        return e.out.str();
+    }
+
+public:
+    static GeneratedWorkload generate(const WorkloadParams& p) {
+        GeneratedWorkload result;
+        if (p.working_set < 1 || p.stride < 1 || p.unroll < 1 || p.accesses < 1 || p.chain_length < 0) {
+            result.error = "working set, stride, unroll and accesses must be positive";
+            return result;
+        }
+        if ((long long)p.stride * (p.unroll - 1) > 0x3FFF) {
+            result.error = "stride * unroll does not fit in a load/store offset";
+            return result;
+        }
+
+        // sequential mode touches index, index + stride, ... so round up to whole iterations
+        int step = p.stride * p.unroll;
+        int working_set = p.random ? p.working_set : (p.working_set + step - 1) / step * step;
+        int iterations = (p.accesses + p.unroll - 1) / p.unroll;
+
+        // same RNG stream for both passes, the first one only measures the code size
+        unsigned int seed = p.seed ? p.seed : 1;
+        AssemblyResult code = Assembler::assemble(generateCode(p, working_set, 0, iterations, seed));
+        // line aligned and directly after the code, so a working set that fits next to the loop in the
+        // direct-mapped cache does not conflict with it
+        result.data_base = ((int)code.words.size() + WORDS_PER_LINE - 1) / WORDS_PER_LINE * WORDS_PER_LINE;
+        if (result.data_base + working_set > RAM_SIZE) {
+            result.error = "working set does not fit in RAM";
+            return result;
+        }
+        result.source = generateCode(p, working_set, result.data_base, iterations, seed);
+        code = Assembler::assemble(result.source);
+        if (!code.ok()) {
+            result.error = code.errors[0];
+            return result;
+        }
+
+        result.image = code.words;
+        result.image.resize(result.data_base + working_set, 0);
+        if (p.random) {
+            // Sattolo's algorithm gives a single cycle, so the chase visits every element at stride spacing
+            unsigned int state = seed ^ 0x9E3779B9u;
+            if (state == 0) state = 1;
+            int elements = max(1, working_set / p.stride);
+            vector<int> order(elements);
+            for (int i = 0; i < elements; i++) order[i] = i * p.stride;
+            for (int i = elements - 1; i > 0; i--) swap(order[i], order[nextRandom(state) % i]);
+            for (int i = 0; i < elements; i++)
+                result.image[result.data_base + order[i]] = order[(i + 1) % elements];
+        }
+        return result;
+    }
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+// xorshift32 pseudo-random numbers for the workload generator and simpoint clustering
+// implemented here rather than taken from <random>, so the same seed gives the same sequence on every compiler
+
+inline unsigned int nextRandom(unsigned int& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// uniform in [0, 1)
+inline double nextUnit(unsigned int& state) { return nextRandom(state) / 4294967296.0; }